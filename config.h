@@ -18,6 +18,7 @@
 
 #define UNICODE_SELECTED_MODES UNICODE_MODE_LINUX, UNICODE_MODE_WINDOWS
 #define COMBO_NO_TIMER
+#define EECONFIG_USER_DATA_SIZE 1728  // snippet log, learned henkan and heatmap, see jp_ime.h
 
 #define HRGN_A 0x3042
 #define HRGN_E 0x3048
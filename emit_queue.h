@@ -0,0 +1,55 @@
+/* Single-producer, single-consumer ring of 32-bit entries, lock-free.
+ * The IME pushes what it types from the main loop; the emission thread in
+ * jp_ime.c types each entry and only then drops it, so an empty queue means
+ * everything has reached the computer. host/sim/emit_stress.c runs the
+ * same code on two pthreads. */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef EMIT_QUEUE_SIZE
+#define EMIT_QUEUE_SIZE 64  // Entries waiting to be typed, a power of two.
+#endif
+
+_Static_assert((EMIT_QUEUE_SIZE & (EMIT_QUEUE_SIZE - 1)) == 0 && EMIT_QUEUE_SIZE <= 0x8000,
+               "EMIT_QUEUE_SIZE must be a power of two that fits the 16-bit indices");
+
+typedef struct {
+  uint32_t         entries[EMIT_QUEUE_SIZE];
+  _Atomic uint16_t head;  // entries pushed, written by the producer only
+  _Atomic uint16_t tail;  // entries dropped, written by the consumer only
+} emit_queue_t;
+
+// Producer side. Returns false if the queue is full.
+static inline bool emit_queue_push(emit_queue_t *q, uint32_t entry) {
+  uint16_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  uint16_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+  if ((uint16_t)(head - tail) == EMIT_QUEUE_SIZE) { return false; }
+  q->entries[head % EMIT_QUEUE_SIZE] = entry;
+  atomic_store_explicit(&q->head, head + 1, memory_order_release);  // publishes the entry
+  return true;
+}
+
+// Consumer side: reads the oldest entry without taking it. Returns false if empty.
+static inline bool emit_queue_peek(emit_queue_t *q, uint32_t *entry) {
+  uint16_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  uint16_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+  if (head == tail) { return false; }
+  *entry = q->entries[tail % EMIT_QUEUE_SIZE];
+  return true;
+}
+
+// Consumer side: takes the entry peeked, freeing its slot.
+static inline void emit_queue_drop(emit_queue_t *q) {
+  uint16_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+}
+
+// Entries pushed and not yet dropped; either side may ask.
+static inline uint16_t emit_queue_depth(emit_queue_t *q) {
+  return atomic_load_explicit(&q->head, memory_order_acquire) -
+         atomic_load_explicit(&q->tail, memory_order_acquire);
+}
@@ -0,0 +1,97 @@
+/* Generated by host/kanapack.py, do not edit. */
+
+#pragma once
+
+#define HENKAN_ENTRIES 125
+#define HENKAN_STRIDE 8
+
+static const uint16_t PROGMEM henkan_index[] = {
+  0, 83, 173, 246, 332, 418, 532, 631, 708, 802, 886, 969, 1052, 1124, 1214, 1286
+};
+
+static const uint8_t PROGMEM henkan_data[] = {
+  0x0F, 0x68, 0x20, 0x3F, 0x61, 0x1B, 0x03, 0xF7, 0x6F, 0x80, 0x3F, 0x85, 0xCD, 0x00, 0x00, 0x0C,
+  0x68, 0x26, 0xE0, 0x03, 0xF6, 0x32, 0x8F, 0xD8, 0xBD, 0x80, 0x00, 0x08, 0x69, 0x70, 0x3F, 0x97,
+  0x52, 0x00, 0x00, 0x08, 0x68, 0x50, 0x3F, 0x8D, 0x64, 0x00, 0x00, 0x08, 0x69, 0x90, 0x3F, 0x79,
+  0xCB, 0x00, 0x00, 0x0B, 0x69, 0xB0, 0x3F, 0x67, 0x1D, 0x03, 0xF9, 0xEB, 0xB0, 0x00, 0x0B, 0x68,
+  0x40, 0x3F, 0x8D, 0xB3, 0x03, 0xF8, 0x11, 0xA0, 0x00, 0x0A, 0x68, 0x41, 0xC0, 0xFD, 0x98, 0x3B,
+  0xEB, 0x80, 0x00, 0x09, 0x68, 0x74, 0x40, 0xFE, 0x60, 0xB4, 0x00, 0x00, 0x0B, 0x68, 0x90, 0x3F,
+  0x5F, 0x8C, 0x03, 0xF8, 0xDE, 0x10, 0x00, 0x08, 0x68, 0xA0, 0x3F, 0x51, 0x44, 0x00, 0x00, 0x08,
+  0x6B, 0x20, 0x3F, 0x59, 0xC9, 0x00, 0x00, 0x0B, 0x6A, 0xA0, 0x3F, 0x96, 0xE8, 0x03, 0xF9, 0x8F,
+  0x40, 0x00, 0x08, 0x0A, 0x40, 0x3F, 0x5B, 0xB6, 0x00, 0x00, 0x08, 0x09, 0xF0, 0x3F, 0x6C, 0x60,
+  0x00, 0x00, 0x1B, 0x08, 0x40, 0x3F, 0x77, 0xF3, 0x03, 0xF6, 0x10, 0xFF, 0xD8, 0x07, 0x40, 0xFD,
+  0x4C, 0xEF, 0xF5, 0xE2, 0xB0, 0x3F, 0x61, 0x0F, 0xFD, 0x7F, 0x5C, 0x00, 0x00, 0x09, 0x0B, 0xE3,
+  0x00, 0xFD, 0xCA, 0xB0, 0x00, 0x00, 0x0C, 0x09, 0x10, 0x3E, 0xC8, 0x0F, 0xD7, 0x11, 0x7E, 0xC4,
+  0x00, 0x00, 0x0B, 0x0A, 0xB0, 0x3F, 0x61, 0x0F, 0xFD, 0x51, 0xCC, 0x00, 0x00, 0x09, 0x09, 0x20,
+  0xC9, 0x03, 0xF5, 0x9B, 0x90, 0x00, 0x08, 0x0A, 0xC0, 0x3F, 0x82, 0x72, 0x00, 0x00, 0x08, 0x0E,
+  0x40, 0x3F, 0x4E, 0x0A, 0x00, 0x00, 0x08, 0x0C, 0x70, 0x3F, 0x6B, 0x4C, 0x00, 0x00, 0x08, 0x0E,
+  0xB0, 0x3F, 0x6D, 0x77, 0x00, 0x00, 0x0B, 0x90, 0x24, 0x00, 0xFD, 0x98, 0x83, 0xF7, 0x53, 0xB0,
+  0x00, 0x0B, 0x90, 0x2C, 0x00, 0xFE, 0x0B, 0xC7, 0xF8, 0xA9, 0xE0, 0x00, 0x0B, 0x91, 0x90, 0x3F,
+  0x99, 0xC5, 0x03, 0xF6, 0xDB, 0x20, 0x00, 0x0B, 0x5D, 0x76, 0xC5, 0x03, 0xED, 0xBF, 0x96, 0x2A,
+  0x00, 0x00, 0x0C, 0x5C, 0x56, 0x9B, 0x18, 0x05, 0xFF, 0x6B, 0xCD, 0x6C, 0x60, 0x00, 0x09, 0x5E,
+  0x7B, 0x80, 0x5F, 0xF8, 0x33, 0x60, 0x00, 0x0C, 0x5C, 0x90, 0xDB, 0x18, 0x05, 0xFF, 0x72, 0x36,
+  0x6C, 0x60, 0x00, 0x09, 0x5C, 0x90, 0xC9, 0x03, 0xF5, 0xF1, 0xF0, 0x00, 0x09, 0x5C, 0x94, 0xC0,
+  0xFD, 0xD4, 0xDC, 0x00, 0x00, 0x0C, 0x5C, 0x64, 0x18, 0x03, 0xF9, 0x7F, 0x3F, 0xDA, 0x5F, 0x40,
+  0x00, 0x09, 0x5C, 0x63, 0x00, 0xFD, 0x65, 0xCC, 0x00, 0x00, 0x0B, 0x14, 0x2F, 0x85, 0x03, 0xEB,
+  0x3F, 0x8B, 0x70, 0x00, 0x00, 0x0A, 0x14, 0x21, 0x2E, 0x03, 0xEB, 0x3E, 0xB4, 0x00, 0x00, 0x08,
+  0x15, 0x70, 0x3F, 0x98, 0x54, 0x00, 0x00, 0x0F, 0x17, 0xE2, 0x00, 0xFE, 0x62, 0xA0, 0x0F, 0xE6,
+  0x2A, 0x3F, 0x90, 0xAA, 0x00, 0x00, 0x0C, 0x17, 0xE2, 0x58, 0x03, 0xF5, 0xBB, 0x6F, 0xD9, 0x73,
+  0xC0, 0x00, 0x0F, 0x16, 0xB0, 0x3F, 0x7D, 0x19, 0x03, 0xF7, 0x95, 0xE0, 0x3F, 0x9A, 0xEA, 0x00,
+  0x00, 0x0F, 0x16, 0x50, 0x3F, 0x5D, 0xDD, 0x03, 0xF6, 0xCB, 0x30, 0x3F, 0x76, 0xAE, 0x00, 0x00,
+  0x15, 0x14, 0x6A, 0x40, 0xFD, 0xBC, 0x8B, 0xF5, 0xB5, 0x70, 0x3F, 0x61, 0x1F, 0xA4, 0x0F, 0xD7,
+  0x9E, 0x7E, 0xE0, 0x00, 0x00, 0x0C, 0x41, 0xC4, 0xC3, 0x03, 0xF5, 0xB6, 0x6F, 0xDA, 0x08, 0x40,
+  0x00, 0x0B, 0x64, 0x0F, 0xD9, 0xCA, 0x00, 0xFD, 0xB0, 0x5C, 0x00, 0x00, 0x10, 0x64, 0x50, 0x80,
+  0xFD, 0xA9, 0x7F, 0xF6, 0x8B, 0x00, 0x3F, 0x6A, 0x5F, 0xFA, 0xC0, 0x00, 0x08, 0x64, 0x70, 0x3F,
+  0x53, 0x17, 0x00, 0x00, 0x10, 0x64, 0x10, 0xC0, 0xFD, 0x98, 0xA3, 0xEB, 0x80, 0xFD, 0xA9, 0x7F,
+  0xF8, 0x0F, 0xD0, 0x00, 0x0C, 0x65, 0xD0, 0xC0, 0xFB, 0x2F, 0xAE, 0x03, 0xF4, 0xEA, 0xC0, 0x00,
+  0x0C, 0x65, 0xD0, 0xC9, 0x03, 0xF4, 0xEA, 0xCF, 0xE4, 0x3F, 0x40, 0x00, 0x0D, 0xF8, 0x51, 0x93,
+  0x0C, 0x0F, 0xE4, 0xA0, 0x3F, 0x88, 0x4C, 0x00, 0x00, 0x08, 0x60, 0xA0, 0x3F, 0x56, 0xFD, 0x00,
+  0x00, 0x09, 0x60, 0xD4, 0x40, 0xFE, 0x3B, 0x28, 0x00, 0x00, 0x12, 0x7C, 0x21, 0xC2, 0x03, 0xF6,
+  0x43, 0xAF, 0xD7, 0x8B, 0xC0, 0xFD, 0x7D, 0x8B, 0xF6, 0x14, 0xB0, 0x00, 0x09, 0x7D, 0xB0, 0x3E,
+  0xCB, 0xF6, 0x71, 0xD0, 0x00, 0x12, 0x4C, 0x39, 0x06, 0x03, 0xF5, 0x16, 0xCF, 0xD5, 0xC4, 0x80,
+  0xFE, 0x2C, 0x6F, 0xF6, 0xF1, 0x40, 0x00, 0x09, 0x4D, 0x3B, 0x00, 0xFD, 0x7F, 0x0C, 0x00, 0x00,
+  0x09, 0x4C, 0x91, 0x00, 0xFB, 0x2F, 0xB3, 0x00, 0x00, 0x0B, 0x4C, 0x9D, 0x40, 0xFE, 0x28, 0x03,
+  0xF8, 0x44, 0x90, 0x00, 0x09, 0xC0, 0xB1, 0x80, 0xC3, 0xF9, 0x8E, 0xF0, 0x00, 0x09, 0x6C, 0x53,
+  0x00, 0xFE, 0x6D, 0x68, 0x00, 0x00, 0x09, 0x6D, 0x85, 0x40, 0xFD, 0xA1, 0x70, 0x00, 0x00, 0x0A,
+  0x13, 0x02, 0x40, 0xFD, 0x3B, 0x57, 0xEE, 0x00, 0x00, 0x0B, 0x10, 0x70, 0x3F, 0x4E, 0x0B, 0x03,
+  0xF8, 0x20, 0xC0, 0x00, 0x0C, 0x12, 0x04, 0x86, 0x03, 0xF8, 0xCE, 0xAF, 0xD5, 0x53, 0xC0, 0x00,
+  0x0C, 0x12, 0xE1, 0x06, 0x03, 0xF5, 0x19, 0x9F, 0xDD, 0xC7, 0xC0, 0x00, 0x0C, 0x10, 0x6D, 0xC6,
+  0x03, 0xF6, 0x5B, 0x0F, 0xE0, 0x17, 0x80, 0x00, 0x09, 0xA4, 0x51, 0x80, 0xFB, 0x0F, 0xB1, 0x00,
+  0x00, 0x0B, 0xA4, 0x47, 0x40, 0xFE, 0x3E, 0x7B, 0xF6, 0x6F, 0x80, 0x00, 0x10, 0xA4, 0x81, 0x84,
+  0xB8, 0x0F, 0xE0, 0x7A, 0xBF, 0x8E, 0xE2, 0xFE, 0x3B, 0x28, 0x00, 0x00, 0x0B, 0xA7, 0x71, 0x80,
+  0xFE, 0x07, 0xAB, 0xF5, 0x20, 0x60, 0x00, 0x0B, 0x38, 0x40, 0x3F, 0x5B, 0xFF, 0xFD, 0x4F, 0xE0,
+  0x00, 0x00, 0x0A, 0x88, 0x50, 0x80, 0xFA, 0xAF, 0xDD, 0x53, 0x00, 0x00, 0x0C, 0x88, 0x68, 0x82,
+  0x03, 0xF5, 0x14, 0x8F, 0xDD, 0x47, 0xC0, 0x00, 0x08, 0x8C, 0x90, 0x3F, 0x59, 0x16, 0x00, 0x00,
+  0x08, 0x8D, 0x50, 0x3F, 0x7A, 0x7A, 0x00, 0x00, 0x0D, 0x1F, 0x64, 0x81, 0x03, 0xF9, 0x8D, 0xFD,
+  0xBF, 0x72, 0x69, 0x00, 0x00, 0x0B, 0x78, 0x24, 0x18, 0x03, 0xED, 0xBF, 0x5B, 0x66, 0x00, 0x00,
+  0x0B, 0x9F, 0x80, 0x3F, 0x57, 0x30, 0xFD, 0x5B, 0xCC, 0x00, 0x00, 0x0B, 0x9E, 0x70, 0x3F, 0x72,
+  0x36, 0x03, 0xF4, 0xE7, 0x30, 0x00, 0x07, 0x81, 0x90, 0x3E, 0xD0, 0x00, 0x00, 0x07, 0x20, 0x0F,
+  0xD8, 0x92, 0xC0, 0x00, 0x0B, 0x21, 0x0A, 0xC0, 0xFD, 0x89, 0x2F, 0xF7, 0xD1, 0x90, 0x00, 0x0C,
+  0x3C, 0x61, 0x2E, 0x03, 0xF9, 0x6F, 0xBF, 0xE3, 0xB2, 0x80, 0x00, 0x0A, 0x3C, 0x69, 0x40, 0xFE,
+  0x5B, 0xEF, 0xEA, 0xC0, 0x00, 0x0D, 0x24, 0x36, 0x5D, 0x0C, 0x0F, 0xD9, 0xDC, 0x7F, 0x4E, 0xAC,
+  0x00, 0x00, 0x07, 0x25, 0x90, 0x3E, 0xC0, 0x00, 0x00, 0x10, 0x24, 0x47, 0x45, 0x18, 0x0F, 0xD5,
+  0xBC, 0xFF, 0x66, 0xF8, 0xFE, 0x64, 0xA0, 0x00, 0x00, 0x0C, 0x25, 0x27, 0xA7, 0x03, 0xF5, 0x3C,
+  0xBF, 0xE4, 0x15, 0x00, 0x00, 0x08, 0x25, 0x60, 0x3F, 0x9C, 0xE5, 0x00, 0x00, 0x0A, 0x30, 0x50,
+  0x3E, 0xDC, 0x0F, 0xD3, 0xBC, 0x80, 0x00, 0x08, 0x32, 0x00, 0x3F, 0x59, 0x0F, 0x00, 0x00, 0x0B,
+  0x31, 0x19, 0x00, 0xFD, 0x50, 0x37, 0xF5, 0x24, 0xD0, 0x00, 0x0E, 0x2A, 0xF1, 0x80, 0xFA, 0xEF,
+  0xAF, 0x03, 0xF4, 0xE8, 0xCF, 0xAF, 0x00, 0x00, 0x0C, 0x2A, 0xF1, 0xB0, 0x03, 0xEB, 0xBE, 0xBF,
+  0xF8, 0xA9, 0xE0, 0x00, 0x08, 0x2A, 0x50, 0x3F, 0x5E, 0xAD, 0x00, 0x00, 0x08, 0xC9, 0x30, 0x3F,
+  0x73, 0x2B, 0x00, 0x00, 0x0B, 0x2C, 0xC0, 0x3F, 0x82, 0xB1, 0x03, 0xF9, 0xF3, 0xB0, 0x00, 0x08,
+  0x2C, 0xB0, 0x3F, 0x6B, 0xCD, 0x00, 0x00, 0x08, 0x2C, 0xD0, 0x3F, 0x66, 0x25, 0x00, 0x00, 0x0C,
+  0xD4, 0x6C, 0x03, 0x03, 0xF7, 0x56, 0xAF, 0xD4, 0xFD, 0xC0, 0x00, 0x09, 0xC4, 0x0F, 0xAE, 0x03,
+  0xF7, 0x06, 0xB0, 0x00, 0x09, 0xC5, 0x01, 0x00, 0xFD, 0x9D, 0xC4, 0x00, 0x00, 0x07, 0xC4, 0x90,
+  0x3E, 0xD4, 0x00, 0x00, 0x08, 0xC4, 0xD0, 0x3F, 0x66, 0x3C, 0x00, 0x00, 0x17, 0xF8, 0xE7, 0x43,
+  0x08, 0x60, 0x3F, 0x75, 0xC5, 0xFE, 0x59, 0x88, 0x0F, 0xDF, 0xE3, 0xBF, 0x5B, 0xB9, 0xFE, 0x59,
+  0x88, 0x00, 0x00, 0x09, 0xCF, 0xE5, 0x40, 0xFD, 0x46, 0xB0, 0x00, 0x00, 0x0B, 0xF9, 0x1B, 0x40,
+  0xFE, 0x43, 0xA3, 0xF5, 0xC4, 0xB0, 0x00, 0x0D, 0xD8, 0x66, 0x5D, 0x0C, 0x0F, 0xD4, 0xB2, 0x7F,
+  0x5F, 0x37, 0x00, 0x00, 0x07, 0xBC, 0x60, 0x3E, 0xBC, 0x00, 0x00, 0x0B, 0x46, 0x70, 0x3F, 0x75,
+  0x3A, 0x03, 0xF8, 0x85, 0x70, 0x00, 0x08, 0x46, 0x80, 0x3F, 0x7A, 0x93, 0x00, 0x00, 0x08, 0xAF,
+  0x80, 0x3F, 0x6C, 0x34, 0x00, 0x00, 0x08, 0xAE, 0x20, 0x3F, 0x5E, 0x97, 0x00, 0x00, 0x08, 0xAE,
+  0x70, 0x3F, 0x90, 0x53, 0x00, 0x00, 0x09, 0xAC, 0xCA, 0xC0, 0xFD, 0x4D, 0x5C, 0x00, 0x00, 0x08,
+  0xAE, 0xB0, 0x3F, 0x80, 0x33, 0x00, 0x00, 0x0B, 0xA8, 0x0F, 0xDD, 0xBB, 0x80, 0xFE, 0x0A, 0xF4,
+  0x00, 0x00, 0x0C, 0x48, 0x67, 0x82, 0x03, 0xF5, 0x54, 0xFF, 0xE6, 0x13, 0x00, 0x00, 0x08, 0xB5,
+  0x10, 0x3F, 0x5C, 0x71, 0x00, 0x00, 0x09, 0xF9, 0x56, 0x40, 0xFE, 0x5B, 0xA8, 0x00, 0x00, 0x08,
+  0x84, 0xD0, 0x3F, 0x59, 0x1C, 0x00, 0x00, 0x0C, 0x59, 0xD0, 0xD6, 0x03, 0xF6, 0x59, 0x9F, 0xDD,
+  0x01, 0x80, 0x00, 0x0C, 0x59, 0xD4, 0xC3, 0x03, 0xF6, 0x5C, 0x5F, 0xE2, 0x13, 0x00, 0x00, 0x07,
+  0x94, 0x71, 0x00, 0xFB, 0xC0, 0x00,
+};
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Read the keyboard's per-layer press counts over raw HID.
+
+  heatmap.py                  # a 5x12 grid per layer that has been used
+  heatmap.py --layer HIRAGANA # just one layer
+  heatmap.py --csv heat.csv   # layer,row,col,presses for a spreadsheet
+  heatmap.py --reset          # zero the counts
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+import ime_hid
+
+LAYERS = {  # jp_ime.h
+    "QWERTY": 0, "HIRAGANA": 1, "KATAKANA": 2, "FUNCS": 5, "GUIS": 6,
+    "HIRAGANA_SUPP": 7, "KATAKANA_SUPP": 8,
+}
+MATRIX_ROWS, MATRIX_COLS = 10, 6  # Preonic rev3
+ROWS, COLS = 5, 12
+PER_REPORT = (ime_hid.REPORT_SIZE - 4) // 2
+
+
+def grid_position(index):
+    """Matrix index to (row, col) on the grid. Rev3 wires the right half of
+    each grid row as matrix rows 5-9."""
+    row, col = divmod(index, MATRIX_COLS)
+    return row % ROWS, col + MATRIX_COLS * (row // ROWS)
+
+
+def read_layer(dev, layer):
+    keys = MATRIX_ROWS * MATRIX_COLS
+    grid = [[0] * COLS for _ in range(ROWS)]
+    for first in range(0, keys, PER_REPORT):
+        reply = ime_hid.check(dev.request([ime_hid.HEAT_READ, 0, layer, first]), "heatmap read")
+        count = min(PER_REPORT, keys - first)
+        for i, presses in enumerate(struct.unpack_from("<%dH" % count, reply, 4)):
+            row, col = grid_position(first + i)
+            grid[row][col] = presses
+    return grid
+
+
+def show(name, grid):
+    total = sum(map(sum, grid))
+    print("%s (%d presses)" % (name, total))
+    for row in grid:
+        print("  " + " ".join("%5d" % n if n else "    ." for n in row))
+    print()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--layer", choices=sorted(LAYERS))
+    ap.add_argument("--csv", metavar="FILE")
+    ap.add_argument("--reset", action="store_true")
+    opts = ap.parse_args()
+
+    dev = ime_hid.Device()
+    if opts.reset:
+        ime_hid.check(dev.request([ime_hid.HEAT_RESET]), "heatmap reset")
+        return
+    names = [opts.layer] if opts.layer else sorted(LAYERS, key=LAYERS.get)
+    grids = {name: read_layer(dev, LAYERS[name]) for name in names}
+
+    if opts.csv:
+        with open(opts.csv, "w", newline="") as f:
+            out = csv.writer(f)
+            out.writerow(["layer", "row", "col", "presses"])
+            for name, grid in grids.items():
+                for r, row in enumerate(grid):
+                    for c, presses in enumerate(row):
+                        out.writerow([name, r, c, presses])
+        return
+    for name, grid in grids.items():
+        if opts.layer or any(map(any, grid)):
+            show(name, grid)
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except ime_hid.HidError as e:
+        sys.exit("error: %s" % e)
@@ -0,0 +1,121 @@
+"""Raw HID transport for the jp_ime firmware, plus a local stand-in.
+
+Device talks to a real Preonic through hidapi (pip install hidapi).
+SimDevice answers the same 32-byte reports with the firmware's code built
+for this computer, so the host tools can be exercised without a keyboard
+attached.
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+REPORT_SIZE = 32
+USAGE_PAGE = 0xFF60  # QMK raw HID defaults
+USAGE = 0x61
+
+# Commands, mirroring the IME_HID_* enum in jp_ime.h
+SNIP_BEGIN = 0x40
+SNIP_DATA = 0x41
+SNIP_COMMIT = 0x42
+SNIP_ERASE = 0x43
+HENKAN_HELLO = 0x50
+HENKAN_QUERY = 0x51   # sent by the keyboard
+HENKAN_CANDS = 0x52
+HENKAN_DONE = 0x53
+STATS = 0x60
+HEAT_READ = 0x61
+HEAT_RESET = 0x62
+
+OK, ERROR, UNKNOWN = 0, 1, 2
+
+SNIP_MAX = 6          # jp_ime.h
+SNIP_PHRASE_MAX = 96
+HENKAN_REMOTE_SIZE = 128
+
+
+class HidError(Exception):
+    pass
+
+
+class Device:
+    def __init__(self, path=None):
+        import hid
+        if path is None:
+            for info in hid.enumerate():
+                if info["usage_page"] == USAGE_PAGE and info["usage"] == USAGE:
+                    path = info["path"]
+                    break
+            else:
+                raise HidError("no raw HID interface found")
+        self.dev = hid.device()
+        self.dev.open_path(path)
+
+    def write(self, payload):
+        report = bytes(payload).ljust(REPORT_SIZE, b"\0")
+        self.dev.write(b"\0" + report)  # report id 0
+
+    def read(self, timeout_ms=1000):
+        """Next report from the keyboard, or None after `timeout_ms`."""
+        report = bytes(self.dev.read(REPORT_SIZE, timeout_ms))
+        return report if len(report) == REPORT_SIZE else None
+
+    def request(self, payload):
+        self.write(payload)
+        reply = self.read()
+        if reply is None:
+            raise HidError("no reply")
+        return reply
+
+
+class SimDevice:
+    """Runs the firmware's own jp_ime.c on this computer, through host/sim/hid_shim.c.
+
+    The shim is built with cc each time, in a scratch directory, with the
+    features rules.mk turns on by default. Its EEPROM lasts as long as the
+    object does.
+    """
+
+    def __init__(self):
+        self.dir = tempfile.TemporaryDirectory()
+        binary = os.path.join(self.dir.name, "hid_shim")
+        subprocess.run(["cc", "-std=gnu11", "-I" + ROOT, "-I" + os.path.join(ROOT, "host", "sim"),
+                        "-DQMK_KEYBOARD_H=\"qmk_host.h\"", "-DIME_HEATMAP_ENABLE",
+                        os.path.join(ROOT, "jp_ime.c"),
+                        os.path.join(ROOT, "host", "sim", "hid_shim.c"), "-o", binary], check=True)
+        self.shim = subprocess.Popen([binary], stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                     text=True, encoding="utf-8")
+        self.keys = None
+
+    def _send(self, line):
+        self.shim.stdin.write(line + "\n")
+        self.shim.stdin.flush()
+
+    def reboot(self):
+        self._send("reboot")
+
+    def expand(self, trigger):
+        """What typing `trigger` and Space on the HIRAGANA layer puts on screen."""
+        if self.keys is None:
+            sys.path.insert(0, os.path.join(ROOT, "host", "sim"))
+            import rollover
+            self.keys = rollover.read_keys()
+        for char in trigger + " ":
+            if char not in self.keys:
+                raise HidError("no key for %r on the HIRAGANA layer" % char)
+            self._send("key %X %X %X" % self.keys[char])
+        self._send("text")
+        return self.shim.stdout.readline().rstrip("\n")
+
+    def request(self, payload):
+        self._send("hid " + " ".join("%02X" % b for b in bytes(payload).ljust(REPORT_SIZE, b"\0")))
+        return bytes.fromhex(self.shim.stdout.readline())
+
+
+def check(reply, what):
+    if reply[1] != OK:
+        raise HidError("%s failed (status %d)" % (what, reply[1]))
+    return reply
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""Read the keyboard's usage counters over raw HID.
+
+  ime_stats.py              # counters since power-up
+  ime_stats.py --reset      # print them, then zero them
+  ime_stats.py --watch 10   # rates over each 10 s interval
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+import ime_hid
+
+FIELDS = ("keys", "kana", "backspaces", "abandoned", "reports")  # ime_stats_t
+
+
+def read(dev, reset=False):
+    reply = ime_hid.check(dev.request([ime_hid.STATS, int(reset)]), "stats")
+    return dict(zip(FIELDS, struct.unpack_from("<%dI" % len(FIELDS), reply, 2)))
+
+
+def show(stats):
+    for name in FIELDS:
+        print("%-11s %10d" % (name, stats[name]))
+    if stats["keys"]:
+        print("%-11s %10.2f" % ("reports/key", stats["reports"] / stats["keys"]))
+        print("%-11s %10.2f" % ("kana/key", stats["kana"] / stats["keys"]))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--reset", action="store_true", help="zero the counters after reading")
+    ap.add_argument("--watch", type=float, metavar="SECONDS", help="print per-minute rates each interval")
+    opts = ap.parse_args()
+
+    dev = ime_hid.Device()
+    if not opts.watch:
+        show(read(dev, opts.reset))
+        return
+    last = read(dev)
+    print(" ".join("%10s" % name for name in FIELDS) + "   (per minute)")
+    while True:
+        time.sleep(opts.watch)
+        now = read(dev)
+        scale = 60 / opts.watch
+        print(" ".join("%10.0f" % ((now[name] - last[name]) * scale) for name in FIELDS))
+        last = now
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except ime_hid.HidError as e:
+        sys.exit("error: %s" % e)
+    except KeyboardInterrupt:
+        pass
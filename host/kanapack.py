@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""Pack kana text into the 6-bit code the firmware streams from flash.
+
+Symbols are 6 bits wide, most significant bit first:
+   0       end of string
+   1..61   PRIMARY[n - 1]: the common hiragana and 、。ー
+  62       shift: the next symbol indexes SECONDARY (rarer kana, symbols,
+           common kanji); its KATAKANA entry toggles katakana output
+  63       escape: the next 16 bits are a raw BMP codepoint
+
+Kana text costs 6 bits a character against 24 as UTF-8. The usual phrase
+kanji cost 12.
+
+Run after editing snippets.def, henkan.dic (or the alphabets below):
+  host/kanapack.py          # rewrites kanapack.h, snippets.h and henkan.h
+"""
+
+import os
+import re
+import sys
+
+PRIMARY = (
+    "のいうしかんたてとにはなるすでがまもこれらりおくきあさっょだけつよせそえわを"
+    "ちどじめみろやゃほごひねふゅばべぶずげむ、。ー"
+)
+KATAKANA = "\0"  # placeholder in SECONDARY for the katakana toggle
+SECONDARY = (
+    "ぁぃぅぇぉぎぐざぜぞぢづぬぱびぴぷへぺぼぽゆゎゐゑゔゕゖ"
+    "「」・！？　" + KATAKANA +
+    "様願疲失礼了解世話会社日本時間今年月人大中事者方何私申致御"
+)
+
+SHIFT, ESCAPE = 62, 63
+
+assert len(PRIMARY) == 61 and len(set(PRIMARY)) == 61
+assert len(SECONDARY) <= 64 and not set(PRIMARY) & set(SECONDARY)
+assert all(chr(c) in PRIMARY + SECONDARY for c in range(0x3041, 0x3097))
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+
+def is_katakana(ch):
+    return 0x30A1 <= ord(ch) <= 0x30F6
+
+
+def symbols(text):
+    """Yields (value, width) pairs for `text`."""
+    kata = False
+    for ch in text:
+        if is_katakana(ch) != kata and (is_katakana(ch) or ch != "ー"):
+            kata = not kata
+            yield SHIFT, 6
+            yield SECONDARY.index(KATAKANA), 6
+        if is_katakana(ch):
+            ch = chr(ord(ch) - 0x60)
+        if ch in PRIMARY:
+            yield PRIMARY.index(ch) + 1, 6
+        elif ch in SECONDARY:
+            yield SHIFT, 6
+            yield SECONDARY.index(ch), 6
+        else:
+            code = ord(ch) + (0x60 if kata and 0x3041 <= ord(ch) <= 0x3096 else 0)
+            if code > 0xFFFF:
+                raise ValueError("%r is outside the BMP" % ch)
+            yield ESCAPE, 6
+            yield code, 16
+
+
+def pack(*texts):
+    """Packs each text with its end symbol into one padded bit stream."""
+    bits, n = 0, 0
+    for text in texts:
+        for value, width in list(symbols(text)) + [(0, 6)]:
+            bits, n = (bits << width) | value, n + width
+    pad = -n % 8
+    return (bits << pad).to_bytes((n + pad) // 8, "big")
+
+
+def unpack(data):
+    """Reference decoder, mirrors send_packed_P in jp_ime.c."""
+    bits = int.from_bytes(data, "big")
+    total = len(data) * 8
+    pos = 0
+
+    def take(width):
+        nonlocal pos
+        pos += width
+        return (bits >> (total - pos)) & ((1 << width) - 1)
+
+    out, kata = [], False
+    while True:
+        sym = take(6)
+        if sym == 0:
+            return "".join(out)
+        if sym == SHIFT:
+            ch = SECONDARY[take(6)]
+            if ch == KATAKANA:
+                kata = not kata
+                continue
+        elif sym == ESCAPE:
+            out.append(chr(take(16)))
+            continue
+        else:
+            ch = PRIMARY[sym - 1]
+        if kata and 0x3041 <= ord(ch) <= 0x3096:
+            ch = chr(ord(ch) + 0x60)
+        out.append(ch)
+
+
+def c_bytes(data):
+    return ", ".join("0x%02X" % b for b in data)
+
+
+def c_alphabet(text):
+    return ", ".join("0x%04X" % (0 if ch == KATAKANA else ord(ch)) for ch in text)
+
+
+HEADER = "/* Generated by host/kanapack.py, do not edit. */\n"
+
+
+def write_alphabets():
+    with open(os.path.join(ROOT, "kanapack.h"), "w") as f:
+        f.write(HEADER + "\n#pragma once\n\n")
+        f.write("#define KANA_SHIFT %d\n#define KANA_ESCAPE %d\n" % (SHIFT, ESCAPE))
+        f.write("#define KANA_KATAKANA 0x0000  // toggle entry in kana_secondary\n\n")
+        f.write("static const uint16_t PROGMEM kana_primary[] = {\n  %s\n};\n\n" % c_alphabet(PRIMARY))
+        f.write("static const uint16_t PROGMEM kana_secondary[] = {\n  %s\n};\n" % c_alphabet(SECONDARY))
+
+
+def write_snippets():
+    src = open(os.path.join(ROOT, "snippets.def"), encoding="utf-8").read()
+    rows = re.findall(r'^SNIP\((\w+),\s*"([^"]*)",\s*"([^"]*)"\)', src, re.M)
+    utf8 = packed = 0
+    with open(os.path.join(ROOT, "snippets.h"), "w", encoding="utf-8") as f:
+        f.write(HEADER + "\n#pragma once\n\n")
+        for name, _, phrase in rows:
+            data = pack(phrase)
+            assert unpack(data) == phrase
+            utf8 += len(phrase.encode()) + 1
+            packed += len(data)
+            f.write("// %s\n" % phrase)
+            f.write("static const uint8_t PROGMEM snip_%s[] = { %s };\n" % (name, c_bytes(data)))
+    return utf8, packed
+
+
+HENKAN_STRIDE = 8   # records per henkan_index sample
+HENKAN_MAX = 8      # jp_ime.h: longest reading, in kana
+
+
+def read_dictionary(path):
+    """Parses SKK okuri-nasi lines into sorted (reading, [candidates])."""
+    entries = {}
+    for line in open(path, encoding="utf-8"):
+        if not line.strip() or line.startswith(";"):
+            continue
+        reading, rest = line.split(" ", 1)
+        cands = [c.split(";")[0] for c in rest.strip().strip("/").split("/")]
+        assert reading not in entries, "duplicate reading %s" % reading
+        assert 0 < len(reading) <= HENKAN_MAX, "reading too long: %s" % reading
+        entries[reading] = cands
+    return sorted(entries.items())
+
+
+def write_dictionary():
+    """Records are a length byte, then the reading and each candidate packed
+    into one stream, closed by an empty candidate. Readings sort by codepoint,
+    the order henkan_compare uses, and henkan_index keeps the offset of every
+    HENKAN_STRIDE-th record."""
+    entries = read_dictionary(os.path.join(ROOT, "henkan.dic"))
+    data, index = bytearray(), []
+    for i, (reading, cands) in enumerate(entries):
+        if i % HENKAN_STRIDE == 0:
+            index.append(len(data))
+        record = pack(reading, *cands, "")
+        assert unpack(record) == reading
+        assert len(record) < 256, "too many candidates for %s" % reading
+        data += bytes([len(record) + 1]) + record
+    assert len(data) < 0x10000
+    with open(os.path.join(ROOT, "henkan.h"), "w", encoding="utf-8") as f:
+        f.write(HEADER + "\n#pragma once\n\n")
+        f.write("#define HENKAN_ENTRIES %d\n#define HENKAN_STRIDE %d\n\n" % (len(entries), HENKAN_STRIDE))
+        f.write("static const uint16_t PROGMEM henkan_index[] = {\n  %s\n};\n\n"
+                % ", ".join(str(o) for o in index))
+        f.write("static const uint8_t PROGMEM henkan_data[] = {\n")
+        for i in range(0, len(data), 16):
+            f.write("  %s,\n" % c_bytes(data[i:i + 16]))
+        f.write("};\n")
+    utf8 = sum(len((r + "".join(c)).encode()) + 1 + len(c) for r, c in entries)
+    return len(entries), len(data) + 2 * len(index), utf8
+
+
+def main():
+    if len(sys.argv) > 1:
+        for text in sys.argv[1:]:
+            data = pack(text)
+            print("%s: %d bytes (UTF-8 %d)" % (text, len(data), len(text.encode()) + 1))
+        return
+    write_alphabets()
+    utf8, packed = write_snippets()
+    print("snippets: %d bytes packed, %d as UTF-8" % (packed, utf8))
+    print("henkan: %d readings, %d bytes packed with index, %d as UTF-8" % write_dictionary())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,357 @@
+#!/usr/bin/env python3
+"""Propose kana-layer key placements from a corpus.
+
+Japanese text is turned into the keys the IME would need, using the rows
+of romaji.def (kanji via the readings in henkan.dic where known). The
+letter, vowel, ん and punctuation keys of the HIRAGANA layer in keymap.c
+are then shuffled over their positions, and any free ones, by simulated
+annealing against a finger and row cost model. One annealing chain runs
+per core.
+
+  layout_opt.py corpus.txt [more.txt ...] [--heatmap heat.csv]
+                [--profile hepburn] [--iterations 200000] [--chains N]
+
+Prints the cost per keystroke of the current and proposed layouts, then
+the HIRAGANA and KATAKANA layers rearranged, ready to paste over their
+LAYOUT_preonic_grid() blocks in keymap.c, and the hiragana_supp[] and
+katakana_supp[] lists of SK(row, column, keycode) entries, the Shift
+forms unicode.def doesn't give. Those are read as grids with KC_TRNS
+where no entry is, follow the same moves so each stays over its base
+key, and are written back as SK() lists.
+"""
+
+import argparse
+import csv
+import math
+import multiprocessing
+import os
+import random
+import re
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+ROWS, COLS = 5, 12
+LAYERS = ("HIRAGANA", "KATAKANA", "HIRAGANA_SUPP", "KATAKANA_SUPP")
+PROFILES = {"permissive": "R_PRM", "hepburn": "R_HEP", "kunrei": "R_KUN", "nihon": "R_NIH"}
+
+# --- Cost model ---
+# Base effort of each grid position: a row factor times a finger factor.
+# Pinkies and stretches to the centre columns cost more; the home row is
+# cheapest. Row 4 is the thumb row in the middle.
+ROW_COST = (3.0, 1.4, 1.0, 1.5, 2.5)
+COL_FINGER = ("LP", "LP", "LR", "LM", "LI", "LI", "RI", "RI", "RI", "RM", "RR", "RP")
+THUMB_FINGER = {3: "LT", 4: "LT", 5: "LT", 6: "RT", 7: "RT", 8: "RT"}
+FINGER_COST = {"P": 1.6, "R": 1.25, "M": 1.0, "I": 1.0, "T": 0.8}
+STRETCH_COLS = {0: 0.6, 5: 0.3, 6: 0.6}
+SAME_FINGER = 2.0     # per different key typed by the same finger in a row, times 1 + rows apart
+ROW_JUMP = 0.6        # same hand, two or more rows apart
+ALTERNATION = -0.15   # hands alternate
+
+
+def finger(pos):
+    row, col = pos
+    return THUMB_FINGER.get(col, COL_FINGER[col]) if row == 4 else COL_FINGER[col]
+
+
+def base_cost(pos):
+    row, col = pos
+    if row == 4 and col in THUMB_FINGER:
+        return ROW_COST[2] * FINGER_COST["T"]
+    return ROW_COST[row] * FINGER_COST[finger(pos)[1]] + STRETCH_COLS.get(col, 0)
+
+
+def pair_cost(a, b):
+    if a == b:
+        return 0.0
+    fa, fb = finger(a), finger(b)
+    if fa[0] != fb[0]:
+        return ALTERNATION
+    if fa == fb:
+        return SAME_FINGER * (1 + abs(a[0] - b[0]))
+    return ROW_JUMP if abs(a[0] - b[0]) >= 2 else 0.0
+
+
+# --- keymap.c ---
+def split_top(text):
+    """Splits on commas outside parentheses."""
+    out, depth, cur = [], 0, ""
+    for ch in text:
+        if ch == "," and depth == 0:
+            out.append(cur.strip())
+            cur = ""
+            continue
+        depth += (ch == "(") - (ch == ")")
+        cur += ch
+    out.append(cur.strip())
+    return out
+
+
+SPARSE = {"HIRAGANA_SUPP": "hiragana_supp", "KATAKANA_SUPP": "katakana_supp"}  # SK() lists in keymap.c
+
+
+def read_layers(source):
+    layers = {}
+    for name in LAYERS:
+        if name in SPARSE:
+            m = re.search(r"sparse_key_t PROGMEM %s\[\] = \{(.*?)\n\};" % SPARSE[name], source, re.S)
+            keys = ["KC_TRNS"] * (ROWS * COLS)
+            for sk in split_top(m.group(1)):
+                if sk:
+                    row, col, keycode = split_top(sk[len("SK("):-1])
+                    keys[int(row) * COLS + int(col)] = keycode
+            layers[name] = keys
+            continue
+        m = re.search(r"\[%s\] = LAYOUT_preonic_grid\(" % name, source)
+        depth, i = 1, m.end()
+        while depth:
+            depth += (source[i] == "(") - (source[i] == ")")
+            i += 1
+        keys = split_top(source[m.end():i - 1])
+        assert len(keys) == ROWS * COLS, name
+        layers[name] = keys
+    return layers
+
+
+KANA_KEYS = {"KANA_%s" % v.upper(): v for v in "aeioun"}
+SYMBOL_KEYS = {"MARK_COMMA": "、", "MARK_PERIOD": "。", "KANA_LONGVOW": "ー"}
+
+
+def key_symbol(keycode):
+    """The romaji letter or kana punctuation a HIRAGANA-layer key types."""
+    m = re.fullmatch(r"KC_([A-Z])", keycode)
+    if m:
+        return m.group(1).lower()
+    m = re.fullmatch(r"UM\((\w+)\)", keycode)
+    if m:
+        return KANA_KEYS.get(m.group(1)) or SYMBOL_KEYS.get(m.group(1))
+    return None
+
+
+def movable_slots(layer):
+    """Positions the optimizer may fill: typing keys and unused KC_NO."""
+    slots = []
+    for i, keycode in enumerate(layer):
+        if i >= COLS and (key_symbol(keycode) or keycode == "KC_NO"):
+            slots.append(i)
+    return slots
+
+
+# --- Corpus to keys ---
+def read_romaji(profile):
+    """Maps kana strings to the shortest romaji typing them under `profile`."""
+    table = {"あ": "a", "い": "i", "う": "u", "え": "e", "お": "o"}  # typed directly
+    for line in open(os.path.join(ROOT, "romaji.def"), encoding="utf-8"):
+        m = re.match(r'\s*ROMA\("(\w+)",\s*([\w| ]+),\s*([\w| ]+),\s*(\w+),\s*(\w+)\)', line)
+        if not m or not m.group(1).islower() or not m.group(1).isalpha():
+            continue
+        keys, profiles, scripts = m.group(1), m.group(2), m.group(3)
+        if "R_ALL" not in profiles and PROFILES[profile] not in profiles:
+            continue
+        if "R_BOTH" not in scripts and "R_HIRA" not in scripts:
+            continue
+        kana = "".join(chr(int(k, 16)) for k in m.group(4, 5) if int(k, 16))
+        if kana not in table or len(keys) < len(table[kana]):
+            table[kana] = keys
+    return table
+
+
+def read_readings():
+    """Maps henkan.dic candidates back to their readings."""
+    readings = {}
+    path = os.path.join(ROOT, "henkan.dic")
+    for line in open(path, encoding="utf-8"):
+        if line.startswith(";") or " " not in line:
+            continue
+        reading, cands = line.split(" ", 1)
+        for cand in cands.strip().strip("/").split("/"):
+            readings.setdefault(cand.split(";")[0], reading)
+    return readings
+
+
+def to_hiragana(text, readings):
+    longest = max(map(len, readings), default=1)
+    out, i = [], 0
+    while i < len(text):
+        for n in range(min(longest, len(text) - i), 0, -1):
+            if text[i:i + n] in readings:
+                out.append(readings[text[i:i + n]])
+                i += n
+                break
+        else:
+            ch = text[i]
+            out.append(chr(ord(ch) - 0x60) if 0x30A1 <= ord(ch) <= 0x30F6 else ch)
+            i += 1
+    return "".join(out)
+
+
+def keystrokes(text, table):
+    """Yields the key symbols for `text`, None where typing breaks off."""
+    i = 0
+    while i < len(text):
+        for n in (3, 2, 1):
+            kana = text[i:i + n]
+            if kana in table:
+                break
+        else:
+            if text[i] in "、。ー":
+                yield text[i]
+            elif text[i] == "っ" and i + 1 < len(text) and text[i + 1] in table \
+                    and table[text[i + 1]][0] not in "aeioun":
+                yield table[text[i + 1]][0]  # doubled consonant
+            elif text[i] == "ん":
+                yield "n"  # the n key types ん, and n + n is ん + n-
+                if i + 1 < len(text) and table.get(text[i + 1], "x")[0] in "aeiouy":
+                    yield None  # n + a would be な: the firmware needs a pause there
+            else:
+                yield None
+            i += 1
+            continue
+        yield from table[kana]
+        i += n
+
+
+def count(paths, table, readings):
+    uni, bi, total = {}, {}, 0
+    for path in paths:
+        with open(path, encoding="utf-8") as f:
+            for line in f:
+                prev = None
+                for sym in keystrokes(to_hiragana(line, readings), table):
+                    if sym is None:
+                        prev = None
+                        continue
+                    uni[sym] = uni.get(sym, 0) + 1
+                    total += 1
+                    if prev:
+                        bi[prev, sym] = bi.get((prev, sym), 0) + 1
+                    prev = sym
+    return uni, bi, total
+
+
+# --- Annealing ---
+class Problem:
+    def __init__(self, slots, symbols, uni, bi):
+        self.slots = slots                       # grid indices
+        self.symbols = symbols                   # slot order of the current layout, None for free
+        self.pos = [divmod(s, COLS) for s in slots]
+        self.base = [base_cost(p) for p in self.pos]
+        self.pair = [[pair_cost(a, b) for b in self.pos] for a in self.pos]
+        self.uni = [uni.get(s, 0) if s else 0 for s in symbols]
+        n = len(symbols)
+        self.bi = [[bi.get((symbols[a], symbols[b]), 0) if symbols[a] and symbols[b] else 0
+                    for b in range(n)] for a in range(n)]
+
+    def cost(self, where):
+        """`where[k]` is the slot holding symbol k of the current layout."""
+        total = sum(u * self.base[where[k]] for k, u in enumerate(self.uni))
+        for a, row in enumerate(self.bi):
+            for b, n in enumerate(row):
+                if n:
+                    total += n * self.pair[where[a]][where[b]]
+        return total
+
+    def involving(self, where, ks):
+        total = sum(self.uni[k] * self.base[where[k]] for k in ks)
+        for k in ks:
+            for x, n in enumerate(self.bi[k]):
+                if n:
+                    total += n * self.pair[where[k]][where[x]]
+            for x in range(len(where)):
+                n = self.bi[x][k]
+                if n and x not in ks:
+                    total += n * self.pair[where[x]][where[k]]
+        return total
+
+
+def anneal(args):
+    problem, iterations, seed = args
+    rng = random.Random(seed)
+    n = len(problem.symbols)
+    where = list(range(n))
+    rng.shuffle(where)
+    cost = problem.cost(where)
+    best, best_cost = where[:], cost
+    temp = cost / max(1, sum(problem.uni)) * 50
+    cooling = (1e-4) ** (1 / iterations)
+    for _ in range(iterations):
+        a, b = rng.sample(range(n), 2)
+        before = problem.involving(where, (a, b))
+        where[a], where[b] = where[b], where[a]
+        delta = problem.involving(where, (a, b)) - before
+        if delta <= 0 or rng.random() < math.exp(-delta / temp):
+            cost += delta
+            if cost < best_cost:
+                best, best_cost = where[:], cost
+        else:
+            where[a], where[b] = where[b], where[a]
+        temp *= cooling
+    return best_cost, best
+
+
+# --- Output ---
+def format_layer(name, keys):
+    """The layer as keymap.c spells it: columns aligned, paren in the last cell;
+    for a sparse layer, its SK() list, a grid row to a line."""
+    if name in SPARSE:
+        lines = ["static const sparse_key_t PROGMEM %s[] = {" % SPARSE[name]]
+        for r in range(ROWS):
+            row = ["SK(%d, %2d, %s)" % (r, c, keys[r * COLS + c]) for c in range(COLS) if keys[r * COLS + c] != "KC_TRNS"]
+            if row:
+                lines.append("  " + ", ".join(row) + ",")
+        return "\n".join(lines + ["};"])
+    keys = keys[:-1] + [keys[-1] + ")"]
+    widths = [max(len(keys[r * COLS + c]) for r in range(ROWS)) for c in range(COLS)]
+    lines = ["[%s] = LAYOUT_preonic_grid(" % name]
+    for r in range(ROWS):
+        lines.append("  " + ", ".join("%-*s" % (widths[c], keys[r * COLS + c]) for c in range(COLS)) + ",")
+    return "\n".join(lines)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("corpus", nargs="+", help="UTF-8 Japanese text")
+    ap.add_argument("--heatmap", help="CSV from host/heatmap.py; HIRAGANA and KATAKANA presses add to key counts")
+    ap.add_argument("--profile", choices=sorted(PROFILES), default="hepburn")
+    ap.add_argument("--iterations", type=int, default=200000, help="per chain")
+    ap.add_argument("--chains", type=int, default=os.cpu_count())
+    ap.add_argument("--seed", type=int, default=1)
+    opts = ap.parse_args()
+
+    layers = read_layers(open(os.path.join(ROOT, "keymap.c"), encoding="utf-8").read())
+    hira = layers["HIRAGANA"]
+    slots = movable_slots(hira)
+    symbols = [key_symbol(hira[s]) for s in slots]
+
+    uni, bi, total = count(opts.corpus, read_romaji(opts.profile), read_readings())
+    if opts.heatmap:
+        with open(opts.heatmap, newline="") as f:
+            for row in csv.DictReader(f):
+                if row["layer"] in ("HIRAGANA", "KATAKANA"):
+                    sym = key_symbol(hira[int(row["row"]) * COLS + int(row["col"])])
+                    if sym:
+                        uni[sym] = uni.get(sym, 0) + int(row["presses"])
+                        total += int(row["presses"])
+    if not total:
+        sys.exit("error: no kana found in the corpus")
+    missing = sorted(set(uni) - set(symbols))
+    if missing:
+        print("not on the HIRAGANA layer, ignored: %s" % " ".join(missing), file=sys.stderr)
+
+    problem = Problem(slots, symbols, uni, bi)
+    current = problem.cost(list(range(len(slots))))
+    jobs = [(problem, opts.iterations, opts.seed + i) for i in range(opts.chains)]
+    with multiprocessing.Pool(opts.chains) as pool:
+        best_cost, where = min(pool.map(anneal, jobs))
+
+    print("// %d keystrokes; cost per keystroke %.3f now, %.3f proposed (%+.1f%%)"
+          % (total, current / total, best_cost / total, 100 * (best_cost / current - 1)))
+    for name in LAYERS:
+        keys = layers[name][:]
+        for k, slot in enumerate(slots):
+            keys[slots[where[k]]] = layers[name][slot]
+        print()
+        print(format_layer(name, keys))
+
+
+if __name__ == "__main__":
+    main()
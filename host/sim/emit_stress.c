@@ -0,0 +1,105 @@
+/* Runs emit_queue.h on two pthreads the way IME_EMIT_THREAD_ENABLE does on
+ * the keyboard, and checks that every entry comes out once and in order.
+ *
+ *   cc -std=gnu11 -O2 -pthread -I. host/sim/emit_stress.c -o emit_stress   # from the keymap folder
+ *   ./emit_stress [bursts [longest [type_us]]]
+ *
+ * The producer pushes `bursts` runs of 1 to `longest` entries (default
+ * 20000 and 200, so many overrun the queue and have to wait for room, as
+ * a long snippet does) with random pauses between, and now and then
+ * drains the queue as the IME does before QMK acts on a key. The consumer
+ * takes `type_us` microseconds over each entry, as register_unicode does
+ * on the keyboard (default 2). Exits 1 if any entry was lost, repeated or
+ * out of order, or if a drain returned before the last entry was typed.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "emit_queue.h"
+
+static emit_queue_t     queue;
+static unsigned         type_us = 2;
+static uint32_t         total;         // entries the producer will push
+static _Atomic uint32_t typed;         // entries the consumer has finished
+static unsigned         out_of_order;
+
+static void spin_us(unsigned us) {
+  struct timespec start, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while ((now.tv_sec - start.tv_sec) * 1000000L + (now.tv_nsec - start.tv_nsec) / 1000 < (long)us);
+}
+
+static void *consume(void *arg) {
+  (void)arg;
+  for (uint32_t want = 0; want < total; want++) {
+    uint32_t entry;
+    while (!emit_queue_peek(&queue, &entry)) {
+      sched_yield();
+    }
+    if (entry != want) {
+      if (out_of_order++ < 10) {
+        fprintf(stderr, "entry %u came out as %u\n", want, entry);
+      }
+      want = entry;
+    }
+    spin_us(type_us);
+    atomic_store(&typed, want + 1);
+    emit_queue_drop(&queue);
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  unsigned bursts  = argc > 1 ? atoi(argv[1]) : 20000;
+  unsigned longest = argc > 2 ? atoi(argv[2]) : 200;
+  type_us          = argc > 3 ? atoi(argv[3]) : 2;
+  if (!bursts || !longest) {
+    fprintf(stderr, "usage: %s [bursts [longest [type_us]]]\n", argv[0]);
+    return 1;
+  }
+
+  srand(1);
+  unsigned *lengths = malloc(bursts * sizeof(*lengths));
+  for (unsigned i = 0; i < bursts; i++) {
+    lengths[i] = 1 + rand() % longest;
+    total += lengths[i];
+  }
+
+  pthread_t consumer;
+  pthread_create(&consumer, NULL, consume, NULL);
+
+  uint32_t next = 0;
+  unsigned full = 0, deepest = 0, drains = 0, early = 0;
+  for (unsigned i = 0; i < bursts; i++) {
+    for (unsigned j = 0; j < lengths[i]; j++, next++) {
+      if (!emit_queue_push(&queue, next)) {
+        full++;
+        while (!emit_queue_push(&queue, next)) {
+          sched_yield();
+        }
+      }
+      uint16_t depth = emit_queue_depth(&queue);
+      deepest        = depth > deepest ? depth : deepest;
+    }
+    if (rand() % 8 == 0) {  // a key QMK types waits for the queue to empty
+      while (emit_queue_depth(&queue)) {
+        sched_yield();
+      }
+      early += atomic_load(&typed) != next;
+      drains++;
+    } else {
+      spin_us(rand() % 50);
+    }
+  }
+  pthread_join(consumer, NULL);
+  free(lengths);
+
+  printf("%u entries in %u bursts: %u out of order, %u pushes waited for room, deepest %u/%u, %u of %u drains early\n",
+         total, bursts, out_of_order, full, deepest, EMIT_QUEUE_SIZE, early, drains);
+  return out_of_order || early || atomic_load(&typed) != total;
+}
@@ -0,0 +1,111 @@
+/* Answers raw HID reports with jp_ime.c, so the host tools can be run
+ * against the firmware's own code without a keyboard attached.
+ *
+ *   cc -std=gnu11 -I. -Ihost/sim -DQMK_KEYBOARD_H='"qmk_host.h"' \
+ *      -DIME_HEATMAP_ENABLE jp_ime.c host/sim/hid_shim.c -o hid_shim   # from the keymap folder
+ *
+ * host/ime_hid.py SimDevice builds and runs it. It reads one command per
+ * line on stdin:
+ *
+ *   hid XX XX ...        a report; the reply comes back as one line of hex
+ *   key KEYCODE ROW COL  taps a key on the HIRAGANA layer, in hex
+ *   text                 prints what the keys typed as UTF-8, and forgets it
+ *   reboot               runs ime_init() again; the EEPROM is kept
+ */
+
+#include <stdlib.h>
+#include "jp_ime.h"
+
+uint32_t sim_clock = 1000;
+uint32_t layer_state;
+uint8_t  sim_mods;
+uint32_t sim_eeconfig_user;
+uint8_t  sim_datablock[EECONFIG_USER_DATA_SIZE];
+
+static uint32_t text[1024];
+static size_t   text_len;
+
+void sim_emit(uint32_t codepoint) {
+  if (codepoint == '\b') {
+    text_len -= text_len > 0;
+  } else if (text_len < ARRAY_SIZE(text)) {
+    text[text_len++] = codepoint;
+  }
+}
+
+void tap_code(uint8_t keycode) {
+  switch (keycode) {
+    case KC_BSPC: sim_emit('\b'); break;
+    case KC_A ... KC_Z: sim_emit('a' + keycode - KC_A); break;
+    case KC_SPC: sim_emit(' '); break;
+    default: break;  // no text
+  }
+}
+
+void raw_hid_send(uint8_t *data, uint8_t length) {
+  for (uint8_t i = 0; i < length; i++) {
+    printf(i ? " %02X" : "%02X", data[i]);
+  }
+  putchar('\n');
+}
+
+static void print_text(void) {
+  for (size_t i = 0; i < text_len; i++) {
+    uint32_t c = text[i];
+    if (c < 0x80) {
+      putchar(c);
+    } else if (c < 0x800) {
+      printf("%c%c", 0xC0 | c >> 6, 0x80 | (c & 0x3F));
+    } else {
+      printf("%c%c%c", 0xE0 | c >> 12, 0x80 | ((c >> 6) & 0x3F), 0x80 | (c & 0x3F));
+    }
+  }
+  putchar('\n');
+  text_len = 0;
+}
+
+// Sends the key's press or release, then lets 30 ms pass a scan at a time.
+static void key_event(uint16_t keycode, uint8_t row, uint8_t col, bool pressed) {
+  keyrecord_t record = {.event = {.key = {.col = col, .row = row}, .pressed = pressed, .time = sim_clock}};
+  if (ime_process_record(keycode, &record) && pressed) {  // what QMK does with it
+    if (IS_QK_UNICODEMAP(keycode)) {
+      sim_emit(unicode_map[QK_UNICODEMAP_GET_INDEX(keycode)]);
+    } else {
+      tap_code(keycode);
+    }
+  }
+  for (uint8_t ms = 0; ms < 30; ms++) {
+    sim_clock++;
+    ime_matrix_scan();
+  }
+}
+
+int main(void) {
+  char line[256];
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  layer_state = 1u << HIRAGANA;
+  ime_init();
+  while (fgets(line, sizeof(line), stdin)) {
+    unsigned keycode, row, col;
+    if (!strncmp(line, "hid ", 4)) {
+      uint8_t report[32] = {0};
+      uint8_t n          = 0;
+      char   *p          = line + 4, *end;
+      for (unsigned long b; n < sizeof(report) && (b = strtoul(p, &end, 16), end != p); p = end) {
+        report[n++] = b;
+      }
+      ime_raw_hid_receive(report, sizeof(report));
+    } else if (sscanf(line, "key %x %x %x", &keycode, &row, &col) == 3 && row < MATRIX_ROWS && col < MATRIX_COLS) {
+      key_event(keycode, row, col, true);
+      key_event(keycode, row, col, false);
+    } else if (!strcmp(line, "text\n")) {
+      print_text();
+    } else if (!strcmp(line, "reboot\n")) {
+      ime_init();
+    } else {
+      fprintf(stderr, "hid_shim: bad command: %s", line);
+      return 1;
+    }
+  }
+  return 0;
+}
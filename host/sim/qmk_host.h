@@ -0,0 +1,105 @@
+/* Just enough of QMK to build jp_ime.c on a computer, for host/sim tools.
+ * Keycodes match QMK's; the clock, layers, mods and EEPROM are variables
+ * the tool drives, and output goes to sim_emit(). */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define pgm_read_ptr(p)  (*(void *const *)(p))
+#define memcpy_P         memcpy
+#define ARRAY_SIZE(a)    (sizeof(a) / sizeof((a)[0]))
+#define MIN(a, b)        ((a) < (b) ? (a) : (b))
+#define MAX(a, b)        ((a) > (b) ? (a) : (b))
+
+#define MATRIX_ROWS 10
+#define MATRIX_COLS 6
+
+// --- Keycodes ---
+enum {
+  KC_NO, KC_TRNS, KC_A = 0x04, KC_B, KC_C, KC_D, KC_E, KC_F, KC_G, KC_H, KC_I, KC_J, KC_K, KC_L, KC_M,
+  KC_N, KC_O, KC_P, KC_Q, KC_R, KC_S, KC_T, KC_U, KC_V, KC_W, KC_X, KC_Y, KC_Z,
+  KC_1, KC_2, KC_3, KC_4, KC_5, KC_6, KC_7, KC_8, KC_9, KC_0,
+  KC_ENT, KC_ESC, KC_BSPC, KC_TAB, KC_SPC, KC_MINS, KC_EQL, KC_LBRC, KC_RBRC, KC_BSLS,
+  KC_NUHS, KC_SCLN, KC_QUOT, KC_GRV, KC_COMM, KC_DOT, KC_SLSH,
+  KC_LCTL = 0xE0, KC_LSFT, KC_LALT, KC_LGUI, KC_RCTL, KC_RSFT, KC_RALT, KC_RGUI
+};
+#define KC_SLASH KC_SLSH
+
+#define QK_ONE_SHOT_MOD     0x52A0
+#define QK_ONE_SHOT_MOD_MAX 0x52BF
+#define UC_NEXT             0x7C30
+#define SAFE_RANGE          0x7E40
+#define QK_UNICODEMAP       0x8000
+#define QK_UNICODEMAP_MAX   0xBFFF
+#define UM(i)               (QK_UNICODEMAP | (i))
+#define IS_QK_UNICODEMAP(kc) ((kc) >= QK_UNICODEMAP && (kc) <= QK_UNICODEMAP_MAX)
+#define QK_UNICODEMAP_GET_INDEX(kc) ((kc) & 0x3FFF)
+extern const uint32_t unicode_map[];  // the keymap's table, in jp_ime.c
+
+#define MOD_MASK_CTRL  0x11
+#define MOD_MASK_SHIFT 0x22
+
+// --- Events ---
+typedef struct { uint8_t col, row; } keypos_t;
+typedef struct { keypos_t key; bool pressed; uint16_t time; } keyevent_t;
+typedef struct { keyevent_t event; } keyrecord_t;
+
+// --- State the tool drives ---
+extern uint32_t sim_clock;    // ms
+extern uint32_t layer_state;
+extern uint8_t  sim_mods;
+extern uint32_t sim_eeconfig_user;
+extern uint8_t  sim_datablock[EECONFIG_USER_DATA_SIZE];
+void sim_emit(uint32_t codepoint);  // a character reached the computer, '\b' deletes
+
+static inline uint16_t timer_read(void) { return sim_clock; }
+static inline uint32_t timer_read32(void) { return sim_clock; }
+static inline uint16_t timer_elapsed(uint16_t t) { return (uint16_t)(sim_clock - t); }
+static inline bool timer_expired(uint16_t now, uint16_t future) { return (uint16_t)(now - future) < 0x8000; }
+static inline bool timer_expired32(uint32_t now, uint32_t future) { return now - future < 0x80000000u; }
+
+#define IS_LAYER_ON(layer) ((layer_state >> (layer)) & 1)
+static inline void layer_on(uint8_t layer) { layer_state |= 1u << layer; }
+static inline void layer_clear(void) { layer_state = 0; }
+static inline uint8_t layer_switch_get_layer(keypos_t key) {
+  (void)key;
+  for (int8_t layer = 31; layer > 0; layer--) {
+    if (IS_LAYER_ON(layer)) { return layer; }
+  }
+  return 0;
+}
+
+// No keymap here: captures carry the keycodes, and the SUPP layers read
+// for Shift come up empty
+static inline uint16_t keymap_key_to_keycode(uint8_t layer, keypos_t key) {
+  (void)layer;
+  (void)key;
+  return KC_TRNS;
+}
+
+static inline uint8_t get_mods(void) { return sim_mods; }
+static inline uint8_t get_oneshot_mods(void) { return 0; }
+
+static inline uint32_t eeconfig_read_user(void) { return sim_eeconfig_user; }
+static inline void eeconfig_update_user(uint32_t value) { sim_eeconfig_user = value; }
+static inline void eeconfig_read_user_datablock(void *data, uint32_t offset, uint32_t size) {
+  memcpy(data, sim_datablock + offset, size);
+}
+static inline void eeconfig_update_user_datablock(const void *data, uint32_t offset, uint32_t size) {
+  memcpy(sim_datablock + offset, data, size);
+}
+
+// --- Output ---
+static inline void register_unicode(uint32_t codepoint) { sim_emit(codepoint); }
+static inline void unicode_input_mode_step(void) {}
+void tap_code(uint8_t keycode);
+#define uprintf printf
@@ -0,0 +1,4 @@
+#pragma once
+
+// Defined by the tool: replay drops replies, hid_shim prints them.
+void raw_hid_send(uint8_t *data, uint8_t length);
@@ -0,0 +1,178 @@
+/* Replays an IME_CAPTURE dump through jp_ime.c with the same timing and
+ * prints what the computer would have received.
+ *
+ *   cc -std=gnu11 -I. -Ihost/sim -DQMK_KEYBOARD_H='"qmk_host.h"' \
+ *      -DIME_HENKAN_ENABLE -DIME_HEATMAP_ENABLE \
+ *      jp_ime.c host/sim/replay.c -o replay        # from the keymap folder
+ *   ./replay [-v] capture.txt                      # or the dump on stdin
+ *
+ * Give it the IME_*_ENABLE flags the keyboard was built with; the captures in
+ * host/sim/cases were made with henkan on, as above.
+ *
+ * The dump is the `qmk console` output after pressing IME_CAPTURE; lines
+ * not starting "ime " are skipped. Between events the clock advances one
+ * millisecond at a time with a matrix scan each, so timeouts fire where
+ * they did on the keyboard. -v prints the text after every event. The
+ * ring may start mid-composition, which replay starts from empty.
+ *
+ * A release must reach QMK exactly when its press did; any that doesn't
+ * is reported and makes the exit status 1. So does text other than that of
+ * an "ime want: <text>" line, which the cases in host/sim/cases carry:
+ *
+ *   for f in host/sim/cases/[a-z]*.txt; do ./replay $f || echo $f; done
+ */
+
+#include <stdlib.h>
+#include "jp_ime.h"
+
+uint32_t sim_clock;
+uint32_t layer_state;
+uint8_t  sim_mods;
+uint32_t sim_eeconfig_user;
+uint8_t  sim_datablock[EECONFIG_USER_DATA_SIZE];
+
+static uint32_t text[4096];
+static size_t   text_len;
+
+// Keys QMK would have registered, to catch releases that don't pair up
+static bool     registered[MATRIX_ROWS][MATRIX_COLS];
+static unsigned unpaired;
+
+void sim_emit(uint32_t codepoint) {
+  if (codepoint == '\b') {
+    text_len -= text_len > 0;
+  } else if (text_len < ARRAY_SIZE(text)) {
+    text[text_len++] = codepoint;
+  }
+}
+
+void tap_code(uint8_t keycode) {
+  switch (keycode) {
+    case KC_BSPC: sim_emit('\b'); break;
+    case KC_A ... KC_Z: sim_emit('a' + keycode - KC_A); break;
+    case KC_1 ... KC_9: sim_emit('1' + keycode - KC_1); break;
+    case KC_0: sim_emit('0'); break;
+    case KC_SPC: sim_emit(' '); break;
+    case KC_ENT: sim_emit('\n'); break;
+    default: break;  // no text
+  }
+}
+
+void raw_hid_send(uint8_t *data, uint8_t length) {
+  (void)data;
+  (void)length;
+}
+
+// What QMK does with a key the IME lets through
+static void pass_through(uint16_t keycode) {
+  if (IS_QK_UNICODEMAP(keycode)) {
+    sim_emit(unicode_map[QK_UNICODEMAP_GET_INDEX(keycode)]);
+  } else if (keycode <= KC_RGUI) {
+    bool shift = sim_mods & MOD_MASK_SHIFT;
+    if (shift && keycode >= KC_A && keycode <= KC_Z) {
+      sim_emit('A' + keycode - KC_A);
+    } else if (!(sim_mods & ~MOD_MASK_SHIFT)) {
+      tap_code(keycode);
+    }
+  }
+}
+
+// Whether the text is `want`, which is UTF-8.
+static bool text_is(const char *want) {
+  size_t i = 0;
+  for (const unsigned char *p = (const unsigned char *)want; *p; i++) {
+    uint32_t c    = *p++;
+    int      more = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    c &= 0x7F >> more;
+    for (; more > 0 && (*p & 0xC0) == 0x80; more--) {
+      c = (c << 6) | (*p++ & 0x3F);
+    }
+    if (i >= text_len || text[i] != c) { return false; }
+  }
+  return i == text_len;
+}
+
+static void print_text(bool one_line) {
+  for (size_t i = 0; i < text_len; i++) {
+    uint32_t c = text[i];
+    if (c == '\n' && one_line) {
+      printf("\\n");
+    } else if (c < 0x80) {
+      putchar(c);
+    } else if (c < 0x800) {
+      printf("%c%c", 0xC0 | c >> 6, 0x80 | (c & 0x3F));
+    } else {
+      printf("%c%c%c", 0xE0 | c >> 12, 0x80 | ((c >> 6) & 0x3F), 0x80 | (c & 0x3F));
+    }
+  }
+  putchar('\n');
+}
+
+int main(int argc, char **argv) {
+  bool  verbose = argc > 1 && !strcmp(argv[1], "-v");
+  FILE *in      = argc > 1 + verbose ? fopen(argv[1 + verbose], "r") : stdin;
+  if (!in) {
+    perror(argv[1 + verbose]);
+    return 1;
+  }
+
+  char     line[256];
+  char     want[256] = "";
+  bool     started   = false;
+  unsigned events  = 0;
+  while (fgets(line, sizeof(line), in)) {
+    const char *ime = strstr(line, "ime ");
+    unsigned    profile, output = 0, time, keycode, pressed, layers, mods, row, col;
+    if (!ime) { continue; }
+    if (!strncmp(ime, "ime want: ", 10)) {
+      snprintf(want, sizeof(want), "%.*s", (int)strcspn(ime + 10, "\n"), ime + 10);
+      continue;
+    }
+    if (sscanf(ime, "ime capture: profile %u, output %u", &profile, &output) >= 1) {
+      sim_eeconfig_user = profile | output << 2;  // ime_config_t.romaji, .output
+      ime_init();
+      started = false;
+      continue;
+    }
+    if (sscanf(ime, "ime ev %u %x %u %x %x %u %u", &time, &keycode, &pressed, &layers, &mods, &row, &col) != 7 ||
+        row >= MATRIX_ROWS || col >= MATRIX_COLS) {
+      continue;
+    }
+
+    if (!started) {
+      sim_clock = time;
+      started   = true;
+    }
+    while ((uint16_t)sim_clock != time) {  // the event clock is 16 bits and wraps
+      sim_clock++;
+      ime_matrix_scan();
+    }
+    layer_state = layers;
+    sim_mods    = mods;
+    keyrecord_t record = {.event = {.key = {.col = col, .row = row}, .pressed = pressed, .time = time}};
+    bool        passed = ime_process_record(keycode, &record);
+    if (passed && pressed) {
+      pass_through(keycode);
+    }
+    if (!pressed && passed != registered[row][col]) {
+      fprintf(stderr, "%u: %04X %s\n", time, keycode, passed ? "released, never pressed" : "left down");
+      unpaired++;
+    }
+    registered[row][col] = pressed && passed;
+    ime_matrix_scan();
+    events++;
+    if (verbose) {
+      printf("%5u %04X %s  ", time, keycode, pressed ? "down" : "up  ");
+      print_text(true);
+    }
+  }
+  if (!verbose) {
+    print_text(false);
+  }
+  fprintf(stderr, "%u events, %u releases not paired with their press\n", events, unpaired);
+  bool wrong = want[0] && !text_is(want);
+  if (wrong) {
+    fprintf(stderr, "want: %s\n", want);
+  }
+  return unpaired != 0 || wrong;
+}
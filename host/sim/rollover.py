@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Writes a synthetic IME_CAPTURE dump of romaji typed fast with rollover.
+
+Each key goes down `--overlap` keystrokes' time before it comes up, so at
+1.5 the next key is always down before the last is released. Keys sit on
+the HIRAGANA layer of keymap.c: letters, vowels, n, Space, Enter (a
+newline), "," "." "-".
+
+  rollover.py "kyou ha ii tenki desu." --wpm 160 > fast.txt
+  replay fast.txt
+  rollover.py --check ./replay "kyou ha ii tenki desu."
+
+--check runs the replay build on the rollover stream and on the same keys
+typed one at a time, and fails unless both give the same text with every
+release paired to its press.
+"""
+
+import argparse
+import os
+import random
+import re
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.join(HERE, "..", "..")
+sys.path.insert(0, os.path.join(HERE, ".."))
+import layout_opt  # noqa: E402
+
+HIRAGANA = 1
+COLS = 12
+MATRIX_COLS = 6  # Preonic rev3: the right half of each grid row is matrix rows 5-9
+KEYCODES = {"KC_SPC": 0x2C, "KC_BSPC": 0x2A, "KC_ENT": 0x28}
+SYMBOLS = {"、": ",", "。": ".", "ー": "-"}
+
+
+def read_unicode_map():
+    """UNICODEMAP index of each UM() name, numbered as jp_ime.h does."""
+    rows = re.findall(r"^(UKEY|UMARK)\((\w+),", open(os.path.join(ROOT, "unicode.def")).read(), re.M)
+    names = [name for kind, name in rows if kind == "UKEY"] + [name for kind, name in rows if kind == "UMARK"]
+    return {name: i for i, name in enumerate(names)}
+
+
+def read_keys():
+    """Maps each character typed here to (keycode, matrix row, matrix col)."""
+    unicode_map = read_unicode_map()
+    source = open(os.path.join(ROOT, "keymap.c"), encoding="utf-8").read()
+    keys = {}
+    for i, name in enumerate(layout_opt.read_layers(source)["HIRAGANA"]):
+        row, col = divmod(i, COLS)
+        pos = (row + 5 * (col // MATRIX_COLS), col % MATRIX_COLS)
+        m = re.fullmatch(r"KC_([A-Z])", name)
+        um = re.fullmatch(r"UM\((\w+)\)", name)
+        if m:
+            keycode = 0x04 + ord(m.group(1)) - ord("A")
+        elif um and um.group(1) in unicode_map:
+            keycode = 0x8000 | unicode_map[um.group(1)]
+        elif name in KEYCODES:
+            keycode = KEYCODES[name]
+        else:
+            continue
+        char = name.lower()[3] if m else layout_opt.key_symbol(name)
+        if name in ("KC_SPC", "KC_ENT"):
+            char = " " if name == "KC_SPC" else "\n"
+        char = SYMBOLS.get(char, char)
+        if char and char not in keys:
+            keys[char] = (keycode, *pos)
+    return keys
+
+
+def dump(presses, keys, hold, profile=0, output=0):
+    """The capture of `presses`, (ms, character) in order, each held `hold` ms."""
+    events = []
+    for i, (down, char) in enumerate(presses):
+        if char not in keys:
+            sys.exit("error: no key for %r on the HIRAGANA layer" % char)
+        up = down + max(1, round(hold))
+        for later, other in presses[i + 1:]:
+            if other == char:  # the same key again has to come up first
+                up = min(up, later - 1)
+                break
+        keycode, row, col = keys[char]
+        events += [(down, 1, keycode, row, col), (up, 0, keycode, row, col)]
+    events.sort(key=lambda e: (e[0], e[1]))  # releases first within a millisecond
+
+    lines = ["ime capture: profile %d, output %d, %d events" % (profile, output, len(events))]
+    for time, pressed, keycode, row, col in events:
+        lines.append("ime ev %u %04X %u %04X %02X %u %u" % (time & 0xFFFF, keycode, pressed, 1 << HIRAGANA, 0, row, col))
+    return "\n".join(lines) + "\n"
+
+
+def stream(text, keys, wpm, overlap, jitter, seed, profile=0, output=0):
+    rng = random.Random(seed)
+    interval = 60000 / (wpm * 5)
+    presses = []
+    t = 1000.0
+    for char in text:
+        presses.append((round(t), char))
+        t += interval * (1 + rng.uniform(-jitter, jitter))
+    return dump(presses, keys, interval * overlap, profile, output)
+
+
+def replay(binary, dump):
+    run = subprocess.run([binary], input=dump.encode(), capture_output=True)
+    return run.stdout.decode("utf-8", "replace"), run.returncode, run.stderr.decode().strip()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("text", nargs="+", help="romaji, typed in turn with Enter-free gaps of one Space")
+    ap.add_argument("--wpm", type=float, default=160)
+    ap.add_argument("--overlap", type=float, default=1.5, help="key hold time, in keystrokes")
+    ap.add_argument("--jitter", type=float, default=0.3, help="random spread of the gaps, as a fraction")
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--profile", type=int, default=0, help="romanization profile, 0-3")
+    ap.add_argument("--output", type=int, default=0, help="output script: 0 kana, 1 full-width, 2 half-width")
+    ap.add_argument("--check", metavar="REPLAY", help="replay binary to compare against one-at-a-time typing")
+    opts = ap.parse_args()
+
+    text = " ".join(opts.text)
+    keys = read_keys()
+    fast = stream(text, keys, opts.wpm, opts.overlap, opts.jitter, opts.seed, opts.profile, opts.output)
+    if not opts.check:
+        sys.stdout.write(fast)
+        return
+
+    got, status, log = replay(opts.check, fast)
+    want, _, _ = replay(opts.check, stream(text, keys, opts.wpm, 0.4, 0, opts.seed, opts.profile, opts.output))
+    print("%.0f wpm, overlap %.1f: %s" % (opts.wpm, opts.overlap, got.strip()))
+    if got != want:
+        print("differs from one key at a time: %s" % want.strip())
+    if status:
+        print(log)
+    sys.exit(got != want or status != 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""Counts composition-timeout mistakes for typists of different speeds.
+
+Each trial warms up on a dozen words typed at the typist's pace and an
+Enter, so the keyboard has learned that pace, then either
+  - hits a stray consonant and hesitates before the next word, which must
+    come out as if the stray key was never pressed (a stale prefix left
+    pending turns "k", pause, "ai" into かい), or
+  - types a word at that pace, which must come out as it does when typed
+    briskly (a timeout inside the word cuts it off).
+
+  timeout_bench.py ./replay_before ./replay_after [--trials 50]
+
+Build each replay binary from the matching tree as host/sim/replay.c says.
+"""
+
+import argparse
+import random
+
+import rollover
+
+WORDS = ("watashi kyou ashita sakura denwa tomodachi shinbun kanji nihongo gakkou "
+         "sensei jikan shigoto kazoku ryokou ongaku eiga toukyou benkyou mondai "
+         "kotoba hon yama umi sora tenki ame kaze hana tsuki").split()
+STRAYS = "ksthmrgbp"  # consonants, held back until a vowel
+
+TYPISTS = (  # name, words per minute, gap spread, pause after a stray key in ms
+    ("fast", 150, 0.3, 900),
+    ("average", 60, 0.4, 1800),
+    ("hunt-and-peck", 5, 0.5, 8000),
+)
+
+
+def presses(words, wpm, jitter, rng, stray=None, pause=0, start=1000):
+    """Press times for `words` typed with Spaces, Enter before the last
+    three; `stray` goes before the last."""
+    interval = 60000 / (wpm * 5)
+    out, t = [], float(start)
+    for i, word in enumerate(words):
+        if i == len(words) - 1 and stray:
+            out.append((round(t), stray))
+            t += pause
+        for char in word + ("\n" if i == len(words) - 4 else " "):
+            out.append((round(t), char))
+            t += interval * (1 + rng.uniform(-jitter, jitter))
+    return out
+
+
+def run_trial(binary, keys, typist, rng, with_stray):
+    _, wpm, jitter, pause = typist
+    words = [rng.choice(WORDS) for _ in range(15)]
+    seed = rng.random()
+    hold = 60000 / (wpm * 5) * 0.8
+
+    if with_stray:
+        stray = rng.choice(STRAYS)
+        typed = presses(words, wpm, jitter, random.Random(seed), stray, pause)
+        clean = presses(words, wpm, jitter, random.Random(seed), None, pause)
+        want_hold = hold
+    else:
+        typed = presses(words, wpm, jitter, random.Random(seed))
+        clean = presses(words, 100, 0, random.Random(seed))
+        want_hold = 60000 / (100 * 5) * 0.8
+    got = rollover.replay(binary, rollover.dump(typed, keys, hold))[0]
+    want = rollover.replay(binary, rollover.dump(clean, keys, want_hold))[0]
+    return got.split("\n")[-2:] != want.split("\n")[-2:]  # after the warm-up
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("replay", nargs="+", help="replay binaries to compare")
+    ap.add_argument("--trials", type=int, default=50, help="of each kind, per typist")
+    ap.add_argument("--seed", type=int, default=1)
+    opts = ap.parse_args()
+
+    keys = rollover.read_keys()
+    print("%-24s %-14s %12s %9s" % ("replay", "typist", "stale prefix", "cut off"))
+    for binary in opts.replay:
+        for typist in TYPISTS:
+            rng = random.Random(opts.seed)  # the same trials for every binary
+            stale = sum(run_trial(binary, keys, typist, rng, True) for _ in range(opts.trials))
+            cut = sum(run_trial(binary, keys, typist, rng, False) for _ in range(opts.trials))
+            print("%-24s %-14s %12s %9s" % (binary, "%s %d" % typist[:2],
+                                             "%d/%d" % (stale, opts.trials), "%d/%d" % (cut, opts.trials)))
+
+
+if __name__ == "__main__":
+    main()
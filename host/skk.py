@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""SKK server protocol (skkserv) client, plus a small server for local use.
+
+A lookup is "1", the reading and a space; the reply is one line:
+  1<reading>     ->  1/candidate/candidate/.../   or  4<reading>  if not found
+  0              ->  close the connection
+  2, 3           ->  server version, host name
+Replies come back in request order, so SkkClient can have several lookups
+in flight before it reads the first answer.
+
+  skk.py serve [--port 1178] [--dict ../henkan.dic] [--delay MS]
+"""
+
+import argparse
+import os
+import socket
+import socketserver
+import threading
+import time
+
+PORT = 1178
+ENCODING = "euc_jp"  # what skkserv and most dictionaries speak
+
+
+def parse_reply(line, encoding=ENCODING):
+    text = line.decode(encoding, "replace").rstrip("\n")
+    if not text.startswith("1/"):
+        return []
+    return [c.split(";")[0] for c in text[2:].rstrip("/").split("/") if c]
+
+
+class SkkClient:
+    def __init__(self, host="127.0.0.1", port=PORT, encoding=ENCODING):
+        self.encoding = encoding
+        self.sock = socket.create_connection((host, port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.replies = self.sock.makefile("rb")
+
+    def send(self, reading):
+        """Starts a lookup. Its answer is the next unread receive()."""
+        self.sock.sendall(b"1" + reading.encode(self.encoding) + b" ")
+
+    def receive(self):
+        line = self.replies.readline()
+        if not line:
+            raise ConnectionError("SKK server closed the connection")
+        return parse_reply(line, self.encoding)
+
+    def lookup(self, reading):
+        self.send(reading)
+        return self.receive()
+
+    def close(self):
+        try:
+            self.sock.sendall(b"0")
+        finally:
+            self.sock.close()
+
+
+def load_dictionary(path, encoding="utf-8"):
+    """Reads SKK okuri-nasi lines into {reading: "/candidate/.../"}."""
+    entries = {}
+    for line in open(path, encoding=encoding):
+        if line.startswith(";") or " " not in line:
+            continue
+        reading, cands = line.rstrip("\n").split(" ", 1)
+        entries[reading] = cands.strip()
+    return entries
+
+
+class MockServer(socketserver.ThreadingTCPServer):
+    """Answers lookups from a dictionary on the loopback interface, each
+    after `delay` seconds. Port 0 picks a free port."""
+
+    daemon_threads = True
+    allow_reuse_address = True
+
+    def __init__(self, entries, port=0, encoding=ENCODING, delay=0.0):
+        self.entries, self.encoding, self.delay = entries, encoding, delay
+        super().__init__(("127.0.0.1", port), _Handler)
+
+    @property
+    def port(self):
+        return self.server_address[1]
+
+    def start(self):
+        threading.Thread(target=self.serve_forever, daemon=True).start()
+        return self
+
+
+class _Handler(socketserver.StreamRequestHandler):
+    def setup(self):
+        super().setup()
+        self.connection.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+    def handle(self):
+        server = self.server
+        while True:
+            cmd = self.rfile.read(1)
+            if cmd in (b"", b"0"):
+                return
+            if cmd == b"1":
+                reading = bytearray()
+                for c in iter(lambda: self.rfile.read(1), b""):
+                    if c in b" \n":
+                        break
+                    reading += c
+                text = reading.decode(server.encoding, "replace")
+                if server.delay:
+                    time.sleep(server.delay)
+                cands = server.entries.get(text)
+                reply = "1%s\n" % cands if cands else "4%s \n" % text
+            elif cmd == b"2":
+                reply = "mock-skkserv 1.0 "
+            elif cmd == b"3":
+                reply = "%s:%d: " % server.server_address
+            else:
+                continue  # whitespace between requests
+            self.wfile.write(reply.encode(server.encoding, "replace"))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("command", choices=["serve"])
+    ap.add_argument("--port", type=int, default=PORT)
+    ap.add_argument("--dict", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "henkan.dic"))
+    ap.add_argument("--dict-encoding", default="utf-8")
+    ap.add_argument("--encoding", default=ENCODING, help="encoding on the wire")
+    ap.add_argument("--delay", type=float, default=0, help="milliseconds before each answer")
+    opts = ap.parse_args()
+
+    server = MockServer(load_dictionary(opts.dict, opts.dict_encoding), opts.port,
+                        opts.encoding, opts.delay / 1000)
+    print("serving %d readings on 127.0.0.1:%d" % (len(server.entries), server.port))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
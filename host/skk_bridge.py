@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Answers the keyboard's henkan queries from an SKK server.
+
+Once the bridge has said hello, the keyboard sends a HENKAN_QUERY for each
+word missing from its flash dictionary. Every query goes on to the server
+at once, without waiting for earlier answers; answers come back in order
+and go to the keyboard as HENKAN_CANDS chunks and a HENKAN_DONE.
+
+  skk_bridge.py [--server HOST:PORT] [--encoding euc_jp]
+  skk_bridge.py --mock       # serve ../henkan.dic from a local mock server
+"""
+
+import argparse
+import collections
+import os
+import sys
+import threading
+
+import ime_hid
+import skk
+
+CHUNK = ime_hid.REPORT_SIZE - 3
+
+
+def answer(seq, reading, cands, room=ime_hid.HENKAN_REMOTE_SIZE):
+    """Reports carrying as many of `cands` as the keyboard has room for."""
+    room -= len(reading.encode()) + 2  # the reading and the closing ""
+    data = b""
+    for cand in cands:
+        cand = cand.encode() + b"\0"
+        if len(data) + len(cand) > room:
+            break
+        data += cand
+    reports = [bytes([ime_hid.HENKAN_CANDS, seq, len(data[i:i + CHUNK])]) + data[i:i + CHUNK]
+               for i in range(0, len(data), CHUNK)]
+    return reports + [bytes([ime_hid.HENKAN_DONE, seq])]
+
+
+class Bridge:
+    def __init__(self, dev, client):
+        self.dev, self.client = dev, client
+        self.pending = collections.deque()  # (seq, reading) sent to the server
+        self.lock = threading.Lock()        # keeps `pending` in server order
+        self.write_lock = threading.Lock()
+        threading.Thread(target=self._answer_loop, daemon=True).start()
+
+    def write(self, report):
+        with self.write_lock:
+            self.dev.write(report)
+
+    def query(self, report):
+        seq, n = report[1], report[2]
+        reading = bytes(report[3:3 + n]).decode("utf-8", "replace")
+        with self.lock:
+            self.pending.append((seq, reading))
+            self.client.send(reading)
+
+    def _answer_loop(self):
+        while True:
+            cands = self.client.receive()
+            with self.lock:
+                seq, reading = self.pending.popleft()
+            for report in answer(seq, reading, cands):
+                self.write(report)
+
+    def run(self):
+        while True:
+            report = self.dev.read(1000)
+            if report is None:
+                self.write([ime_hid.HENKAN_HELLO])  # the keyboard forgets us after a timeout
+            elif report[0] == ime_hid.HENKAN_QUERY:
+                self.query(report)
+            elif report[1] != ime_hid.OK:
+                print("keyboard refused report 0x%02X (status %d)" % (report[0], report[1]), file=sys.stderr)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--server", default="127.0.0.1:%d" % skk.PORT)
+    ap.add_argument("--encoding", default=skk.ENCODING)
+    ap.add_argument("--mock", action="store_true", help="start a mock server on a free local port")
+    opts = ap.parse_args()
+
+    host, port = opts.server.rsplit(":", 1)
+    if opts.mock:
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "henkan.dic")
+        host, port = "127.0.0.1", skk.MockServer(skk.load_dictionary(path), encoding=opts.encoding).start().port
+    bridge = Bridge(ime_hid.Device(), skk.SkkClient(host, int(port), opts.encoding))
+    bridge.write([ime_hid.HENKAN_HELLO])
+    bridge.run()
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except (ime_hid.HidError, OSError) as e:
+        sys.exit("error: %s" % e)
+    except KeyboardInterrupt:
+        pass
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Measures henkan round trips against the mock SKK server, offline.
+
+The server runs on the loopback interface with the keyboard's own
+dictionary. Three timings are reported:
+  serial     one lookup at a time through SkkClient
+  pipelined  every lookup sent before the first answer is read
+  bridge     query report in, HENKAN_DONE out, with a stand-in keyboard
+
+  skk_latency.py [-n 500] [--delay MS]
+"""
+
+import argparse
+import os
+import queue
+import statistics
+import time
+
+import ime_hid
+import skk
+import skk_bridge
+
+
+class LoopDevice:
+    """Collects what the bridge sends to the keyboard."""
+
+    def __init__(self):
+        self.to_keyboard = queue.Queue()
+
+    def write(self, report):
+        self.to_keyboard.put(bytes(report))
+
+    def read(self, timeout_ms=1000):
+        return None
+
+
+def summary(name, seconds):
+    ms = sorted(s * 1000 for s in seconds)
+    print("%-10s n=%-5d min %.3f  median %.3f  p95 %.3f  max %.3f ms"
+          % (name, len(ms), ms[0], statistics.median(ms), ms[int(len(ms) * 0.95) - 1], ms[-1]))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("-n", type=int, default=500, help="lookups per measurement")
+    ap.add_argument("--delay", type=float, default=0, help="server milliseconds per answer")
+    opts = ap.parse_args()
+
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "henkan.dic")
+    entries = skk.load_dictionary(path)
+    server = skk.MockServer(entries, delay=opts.delay / 1000).start()
+    readings = (list(entries) * (opts.n // len(entries) + 1))[:opts.n]
+
+    client = skk.SkkClient(port=server.port)
+    times = []
+    for reading in readings:
+        start = time.perf_counter()
+        assert client.lookup(reading), reading
+        times.append(time.perf_counter() - start)
+    summary("serial", times)
+
+    start = time.perf_counter()
+    for reading in readings:
+        client.send(reading)
+    for reading in readings:
+        assert client.receive(), reading
+    elapsed = time.perf_counter() - start
+    print("%-10s n=%-5d %.3f ms total, %.3f ms per lookup"
+          % ("pipelined", len(readings), elapsed * 1000, elapsed * 1000 / len(readings)))
+    client.close()
+
+    dev = LoopDevice()
+    bridge = skk_bridge.Bridge(dev, skk.SkkClient(port=server.port))
+    times = []
+    for i, reading in enumerate(readings):
+        data = reading.encode()
+        report = bytes([ime_hid.HENKAN_QUERY, i & 0xFF, len(data)]) + data
+        start = time.perf_counter()
+        bridge.query(report)
+        while dev.to_keyboard.get()[0] != ime_hid.HENKAN_DONE:
+            pass
+        times.append(time.perf_counter() - start)
+    summary("bridge", times)
+
+
+if __name__ == "__main__":
+    main()
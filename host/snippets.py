@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Load user snippets into the keyboard over raw HID.
+
+  snippets.py add TRIGGER PHRASE
+  snippets.py del TRIGGER
+  snippets.py load FILE      # one "trigger<TAB>phrase" per line
+  snippets.py erase
+
+--sim runs against jp_ime.c built for this computer (host/sim/hid_shim.c)
+and prints what each trigger then types when followed by Space. With it,
+
+  snippets.py --sim check host/sim/cases/snippet_reuse.snip
+
+runs a case: lines "add TRIGGER PHRASE", "del TRIGGER", "reboot" and
+"want TRIGGER TEXT", the text TRIGGER and Space must type, trailing
+spaces aside. It fails on the first command the keyboard refuses or the
+first wrong text.
+
+Deleting a user snippet that overrides a built-in brings the built-in
+back; deleting the built-in removes it until the trigger is added again.
+"""
+
+import argparse
+import sys
+
+import ime_hid
+
+CHUNK = ime_hid.REPORT_SIZE - 2
+
+
+def put(dev, trigger, phrase):
+    trigger, phrase = trigger.encode("ascii"), phrase.encode("utf-8")
+    if not 0 < len(trigger) <= ime_hid.SNIP_MAX or not trigger[:1].isalpha():
+        raise ime_hid.HidError("trigger must be 1-%d romaji letters" % ime_hid.SNIP_MAX)
+    if len(phrase) > ime_hid.SNIP_PHRASE_MAX:
+        raise ime_hid.HidError("phrase longer than %d bytes" % ime_hid.SNIP_PHRASE_MAX)
+    ime_hid.check(dev.request([ime_hid.SNIP_BEGIN, len(trigger)] + list(trigger)), "begin")
+    for i in range(0, len(phrase), CHUNK):
+        chunk = phrase[i:i + CHUNK]
+        ime_hid.check(dev.request([ime_hid.SNIP_DATA, len(chunk)] + list(chunk)), "data")
+    ime_hid.check(dev.request([ime_hid.SNIP_COMMIT]), "commit")
+
+
+def run_case(dev, path):
+    with open(path, encoding="utf-8") as f:
+        for n, line in enumerate(f, 1):
+            words = line.split(None, 2)
+            try:
+                if not words or words[0].startswith("#"):
+                    continue
+                elif words[0] == "add" and len(words) == 3:
+                    put(dev, words[1], words[2].rstrip("\n"))
+                elif words[0] == "del" and len(words) == 2:
+                    put(dev, words[1], "")
+                elif words[0] == "reboot" and len(words) == 1:
+                    dev.reboot()
+                elif words[0] == "want" and len(words) == 3:
+                    got, want = dev.expand(words[1]).rstrip(" "), words[2].rstrip("\n ")
+                    if got != want:
+                        raise ime_hid.HidError("%s types %r, not %r" % (words[1], got, want))
+                else:
+                    raise ime_hid.HidError("bad line")
+            except ime_hid.HidError as e:
+                raise ime_hid.HidError("%s:%d: %s" % (path, n, e))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--sim", action="store_true", help="use the firmware code built for this computer")
+    ap.add_argument("command", choices=["add", "del", "load", "erase", "check"])
+    ap.add_argument("args", nargs="*")
+    opts = ap.parse_args()
+
+    dev = ime_hid.SimDevice() if opts.sim else ime_hid.Device()
+    triggers = []
+    if opts.command == "add" and len(opts.args) == 2:
+        put(dev, *opts.args)
+        triggers.append(opts.args[0])
+    elif opts.command == "del" and len(opts.args) == 1:
+        put(dev, opts.args[0], "")
+        triggers.append(opts.args[0])
+    elif opts.command == "load" and len(opts.args) == 1:
+        with open(opts.args[0], encoding="utf-8") as f:
+            for line in f:
+                if line.strip() and not line.startswith("#"):
+                    trigger, phrase = line.rstrip("\n").split("\t", 1)
+                    put(dev, trigger, phrase)
+                    triggers.append(trigger)
+    elif opts.command == "check" and len(opts.args) == 1 and opts.sim:
+        run_case(dev, opts.args[0])
+        return
+    elif opts.command == "erase" and not opts.args:
+        ime_hid.check(dev.request([ime_hid.SNIP_ERASE]), "erase")
+    else:
+        ap.error("wrong arguments for %s" % opts.command)
+
+    if opts.sim:
+        dev.reboot()
+        for trigger in triggers:
+            print("%s -> %s" % (trigger, dev.expand(trigger)))
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except ime_hid.HidError as e:
+        sys.exit("error: %s" % e)
@@ -1,36 +1,1626 @@
 #include "jp_ime.h"
+#include "raw_hid.h"
+#include "host.h"
+#include "kanapack.h"
 // Start Recent Key Rememering:
 // https://getreuer.info/posts/keyboards/triggers/index.html#based-on-previously-typed-keys
 #include <string.h>
+#ifdef IME_EMIT_THREAD_ENABLE
+#include <ch.h>
+#include "emit_queue.h"
+#endif
 
-static uint16_t recent[RECENT_SIZE] = {KC_NO};
+static char     recent[RECENT_SIZE + 1] = {0};  // pending romaji, NUL-terminated
+static uint8_t  recent_len = 0;    // keys held in `recent`
+static uint8_t  recent_shown = 0;  // of those, keys already typed to the host
 static uint16_t deadline = 0;
+static uint16_t key_time = 0;      // when the last key of `recent` went down
+static uint16_t timeout = TIMEOUT_MS;
+static bool     timed_out = false;  // `recent` was given up waiting for the next key
+
+static char     snip_keys[SNIP_MAX];  // romaji typed since the last word boundary
+static uint8_t  snip_len = 0;         // keys in `snip_keys`, SNIP_OFF if no trigger can match
+static uint16_t snip_hash = 0;        // running hash of `snip_keys`
+static uint8_t  snip_shown = 0;       // characters they put on screen before `word` restarted
+static uint16_t word[HENKAN_MAX];     // characters those keys put on screen, as hiragana
+static uint8_t  word_len = 0;         // count of them, may run past HENKAN_MAX
+static uint16_t last_kana = 0;        // kana the IME just typed, while still last on screen
+
+#ifdef IME_HENKAN_ENABLE
+enum {
+  HENKAN_OFF,
+  HENKAN_FLASH,    // converting an entry of henkan.dic
+  HENKAN_WAITING,  // asked the host helper, reading still on screen
+  HENKAN_REMOTE    // converting with candidates from the helper
+};
+
+static uint8_t        henkan_state = HENKAN_OFF;
+static const uint8_t *henkan_record;  // entry being converted, in PROGMEM
+static uint8_t        henkan_cand;    // candidate on screen, 0 for the reading
+static uint8_t        henkan_shown;   // characters it put on screen
+static uint16_t       henkan_hash;    // of the reading being converted
+
+static bool     henkan_host = false;  // a helper said hello over raw HID
+static uint8_t  henkan_seq = 0;       // id of the latest query
+static uint16_t henkan_deadline = 0;
+static char     henkan_remote[HENKAN_REMOTE_SIZE];  // reading then candidates, NUL ended, "" last
+static uint8_t  henkan_remote_len;
+#endif
+
+static ime_config_t ime_config;
+static ime_stats_t  ime_stats;
 
 void clear_recent_keys(void) {
-  memset(recent, 0, sizeof(recent));  // Set all zeros (KC_NO).
+  ime_stats.kana += recent_shown;  // kana keys typed ahead stay on screen
+  memset(recent, 0, sizeof(recent));  // Set all zeros (no pending romaji).
+  recent_len = 0;
+  recent_shown = 0;
+}
+
+// Drops an unfinished composition, counting it if it held back consonants.
+static void abandon_recent_keys(void) {
+  if (recent_len > recent_shown) {
+    ime_stats.abandoned++;
+  }
+  clear_recent_keys();
+}
+
+#ifdef IME_TRACE_ENABLE
+// --- Latency trace ---
+// The last TRACE_SIZE presses, each with how long after the press the first
+// keyboard report went out and how many reports it caused: those before
+// the next press, or with IME_EMIT_THREAD_ENABLE those typing its text.
+// IME_TRACE prints them to the console, oldest first.
+#define TRACE_NO_REPORT UINT16_MAX
+
+typedef struct {
+  uint16_t keycode;
+  uint16_t time;     // record->event.time of the press
+  uint16_t latency;  // ms to the first report, TRACE_NO_REPORT if none
+  uint16_t reports;
+} trace_entry_t;
+
+static trace_entry_t  trace[TRACE_SIZE];
+static uint16_t       trace_head = 0;  // next entry to write
+static bool           trace_full = false;
+static trace_entry_t *trace_open = NULL;  // the latest press
+
+static void trace_press(uint16_t keycode, keyrecord_t *record) {
+  trace_open  = &trace[trace_head];
+  *trace_open = (trace_entry_t){keycode, record->event.time, TRACE_NO_REPORT, 0};
+  trace_head  = (trace_head + 1) % TRACE_SIZE;
+  trace_full |= trace_head == 0;
+}
+
+static void trace_report(trace_entry_t *entry) {
+  if (!entry) { return; }
+  if (entry->latency == TRACE_NO_REPORT) {
+    entry->latency = timer_elapsed(entry->time);
+  }
+  if (entry->reports < UINT16_MAX) {
+    entry->reports++;
+  }
+}
+
+static void dump_trace(void) {
+  uint16_t count = trace_full ? TRACE_SIZE : trace_head;
+  uprintf("ime trace, %u presses: time keycode ms reports\n", count);
+  for (uint16_t i = 0; i < count; i++) {
+    const trace_entry_t *e = &trace[(trace_head + TRACE_SIZE - count + i) % TRACE_SIZE];
+    if (e->latency == TRACE_NO_REPORT) {
+      uprintf("%5u %04X   - 0\n", e->time, e->keycode);
+    } else {
+      uprintf("%5u %04X %3u %u\n", e->time, e->keycode, e->latency, e->reports);
+    }
+  }
+}
+#endif
+
+// --- Emission ---
+// With IME_EMIT_THREAD_ENABLE, what the IME types is pushed onto a queue and
+// typed by a low-priority thread, so a long phrase or a slow Unicode input
+// mode doesn't hold up the matrix scan. Keyboard reports then go out from
+// two threads, never at once: each key event waits for the queue to empty
+// before the IME looks at it, since while the thread types QMK's mods are
+// the Unicode input's rather than the user's, and a key QMK acts on waits
+// again, so its report follows the text. Without it, everything is typed
+// on the spot.
+#ifdef IME_EMIT_THREAD_ENABLE
+#define EMIT_TAP         0x80000000UL  // a keycode to tap rather than a codepoint
+#define EMIT_TRACED      0x40000000UL  // the press that typed it is in the trace,
+#define EMIT_TRACE_SHIFT 22            // at this index
+#define EMIT_CODEPOINT   0x001FFFFFUL
+
+static emit_queue_t       emit_queue;
+static binary_semaphore_t emit_ready;  // signalled after each push
+static thread_t          *emit_thread_ref;
+static THD_WORKING_AREA(emit_thread_wa, 512);
+#ifdef IME_TRACE_ENABLE
+_Static_assert(TRACE_SIZE <= 256, "trace index outgrew the queue entry");
+static trace_entry_t *trace_emitting = NULL;  // press whose text the thread is typing
+#endif
+
+static THD_FUNCTION(emit_thread, arg) {
+  (void)arg;
+  chRegSetThreadName("ime_emit");
+  for (;;) {
+    uint32_t entry;
+    while (!emit_queue_peek(&emit_queue, &entry)) {
+      chBSemWait(&emit_ready);
+    }
+#ifdef IME_TRACE_ENABLE
+    trace_emitting = entry & EMIT_TRACED ? &trace[(entry >> EMIT_TRACE_SHIFT) & 0xFF] : NULL;
+#endif
+    if (entry & EMIT_TAP) {
+      tap_code(entry & 0xFF);
+    } else {
+      register_unicode(entry & EMIT_CODEPOINT);
+    }
+    emit_queue_drop(&emit_queue);
+  }
+}
+
+static void start_emit_thread(void) {
+  chBSemObjectInit(&emit_ready, true);
+  emit_thread_ref = chThdCreateStatic(emit_thread_wa, sizeof(emit_thread_wa), NORMALPRIO - 1, emit_thread, NULL);
+}
+
+// Blocks while the queue is full: a burst longer than the queue goes out
+// at the thread's pace.
+static void emit(uint32_t entry) {
+#ifdef IME_TRACE_ENABLE
+  if (trace_open) {
+    entry |= EMIT_TRACED | (uint32_t)(trace_open - trace) << EMIT_TRACE_SHIFT;
+  }
+#endif
+  while (!emit_queue_push(&emit_queue, entry)) {
+    chThdSleepMilliseconds(1);
+  }
+  chBSemSignal(&emit_ready);
+}
+
+static void emit_unicode(uint32_t codepoint) {
+  emit(codepoint);
+}
+
+static void emit_tap(uint8_t keycode) {
+  emit(EMIT_TAP | keycode);
+}
+
+// Waits until everything queued has been typed.
+static void drain_emit_queue(void) {
+  while (emit_queue_depth(&emit_queue)) {
+    chThdSleepMilliseconds(1);
+  }
+}
+
+// The main loop never sleeps, so it gives the thread a tick while there is
+// text waiting.
+static void yield_to_emit_thread(void) {
+  if (emit_queue_depth(&emit_queue)) {
+    chThdSleepMilliseconds(1);
+  }
+}
+
+#ifdef IME_TRACE_ENABLE
+// The press a keyboard report belongs to: the one whose text the thread is
+// typing, else the latest.
+static trace_entry_t *trace_owner(void) {
+  return chThdGetSelfX() == emit_thread_ref ? trace_emitting : trace_open;
+}
+#endif
+#else
+static void emit_unicode(uint32_t codepoint) {
+  register_unicode(codepoint);
+}
+
+static void emit_tap(uint8_t keycode) {
+  tap_code(keycode);
+}
+
+static void drain_emit_queue(void) {}
+
+#ifdef IME_TRACE_ENABLE
+static trace_entry_t *trace_owner(void) {
+  return trace_open;
+}
+#endif
+#endif
+
+static void tap_backspace(void) {
+  last_kana = 0;
+  emit_tap(KC_BSPC);
+  ime_stats.backspaces++;
+}
+
+#ifdef IME_CAPTURE_ENABLE
+// --- Capture ---
+// The last CAPTURE_SIZE events seen by ime_process_record, presses and
+// releases, with the layers and mods they met. IME_CAPTURE prints them to
+// the console; host/sim/replay feeds such a dump back through this file
+// with the same timing.
+typedef struct {
+  uint16_t keycode;
+  uint16_t time;     // record->event.time
+  uint16_t layers;   // layer_state, low 16 layers
+  uint8_t  mods;     // get_mods() | get_oneshot_mods()
+  uint8_t  pressed;
+  keypos_t key;
+} capture_entry_t;
+
+static capture_entry_t capture[CAPTURE_SIZE];
+static uint16_t        capture_head = 0;  // next entry to write
+static bool            capture_full = false;
+
+static void capture_event(uint16_t keycode, keyrecord_t *record) {
+  capture[capture_head] = (capture_entry_t){
+    keycode, record->event.time, (uint16_t)layer_state,
+    get_mods() | get_oneshot_mods(), record->event.pressed, record->event.key
+  };
+  capture_head = (capture_head + 1) % CAPTURE_SIZE;
+  capture_full |= capture_head == 0;
+}
+
+static void dump_capture(void) {
+  uint16_t count = capture_full ? CAPTURE_SIZE : capture_head;
+  uprintf("ime capture: profile %u, output %u, %u events\n", ime_config.romaji, ime_config.output, count);
+  for (uint16_t i = 0; i < count; i++) {
+    const capture_entry_t *e = &capture[(capture_head + CAPTURE_SIZE - count + i) % CAPTURE_SIZE];
+    uprintf("ime ev %u %04X %u %04X %02X %u %u\n", e->time, e->keycode, e->pressed, e->layers, e->mods,
+            e->key.row, e->key.col);
+  }
+}
+#endif
+
+// --- Telemetry ---
+// Keyboard reports are counted on their way to the USB driver by a copy of
+// the host driver with send_keyboard wrapped. The driver is only set once
+// USB is up, after keyboard_post_init_user, so the copy is made from the
+// matrix scan instead.
+static host_driver_t counting_driver;
+static void (*send_keyboard_report)(report_keyboard_t *);
+
+static void count_keyboard_report(report_keyboard_t *report) {
+  // atomic: the emission thread sends reports too, and the main loop can
+  // preempt it halfway through an increment
+  __atomic_fetch_add(&ime_stats.reports, 1, __ATOMIC_RELAXED);
+#ifdef IME_TRACE_ENABLE
+  trace_report(trace_owner());
+#endif
+  send_keyboard_report(report);
+}
+
+static void count_reports(void) {
+  host_driver_t *driver = host_get_driver();
+  if (!driver || driver == &counting_driver) { return; }
+  counting_driver               = *driver;
+  send_keyboard_report          = driver->send_keyboard;
+  counting_driver.send_keyboard = count_keyboard_report;
+  host_set_driver(&counting_driver);
+}
+
+#ifdef IME_HEATMAP_ENABLE
+// --- Heatmap ---
+// Presses per matrix position on the layer each one landed on. Counts stop
+// at UINT16_MAX rather than wrap. While they change, a snapshot goes to
+// EEPROM every HEAT_SNAPSHOT_MS.
+#define HEAT_MAGIC 0x4D48
+#define HEAT_KEYS (MATRIX_ROWS * MATRIX_COLS)
+
+static uint16_t heat[IME_LAYERS][HEAT_KEYS];
+static bool     heat_dirty = false;
+static uint32_t heat_deadline;
+
+_Static_assert(sizeof(uint16_t) + sizeof(heat) <= HEAT_SIZE, "HEAT_SIZE too small");
+
+static void load_heatmap(void) {
+  uint16_t magic;
+  eeconfig_read_user_datablock(&magic, HEAT_OFFSET, sizeof(magic));
+  if (magic == HEAT_MAGIC) {
+    eeconfig_read_user_datablock(heat, HEAT_OFFSET + sizeof(magic), sizeof(heat));
+  } else {
+    memset(heat, 0, sizeof(heat));
+  }
+}
+
+static void snapshot_heatmap(void) {
+  if (!heat_dirty || !timer_expired32(timer_read32(), heat_deadline)) { return; }
+  uint16_t magic = HEAT_MAGIC;
+  eeconfig_update_user_datablock(heat, HEAT_OFFSET + sizeof(magic), sizeof(heat));
+  eeconfig_update_user_datablock(&magic, HEAT_OFFSET, sizeof(magic));
+  heat_dirty = false;
+}
+
+static void mark_heatmap(void) {
+  if (!heat_dirty) {
+    heat_dirty    = true;
+    heat_deadline = timer_read32() + HEAT_SNAPSHOT_MS;
+  }
+}
+
+static void count_press(keyrecord_t *record) {
+  keypos_t key = record->event.key;
+  if (key.row >= MATRIX_ROWS || key.col >= MATRIX_COLS) { return; }  // combos and the like
+
+  uint8_t layer = layer_switch_get_layer(key);
+  if (layer >= IME_LAYERS) { return; }
+  uint16_t *count = &heat[layer][key.row * MATRIX_COLS + key.col];
+  if (*count < UINT16_MAX) {
+    (*count)++;
+    mark_heatmap();
+  }
+}
+#endif
+
+static void sort_romaji_table(void);
+static void build_snippet_index(void);
+static void clear_snippet_keys(void);
+#ifdef IME_HOLD_ENABLE
+static void check_held_key(void);
+#endif
+#ifdef IME_HENKAN_ENABLE
+static void load_henkan_learned(void);
+static void flush_henkan_learned(void);
+static void settle_henkan(void);
+#endif
+
+// --- Lifecycle ---
+void ime_init(void) {
+  ime_config.raw = eeconfig_read_user();
+  if (ime_config.romaji >= ROMA_PROFILES) {
+    ime_config.romaji = ROMA_PERMISSIVE;
+  }
+  if (ime_config.output >= OUT_SCRIPTS) {
+    ime_config.output = OUT_KANA;
+  }
+  sort_romaji_table();
+  build_snippet_index();
+#ifdef IME_EMIT_THREAD_ENABLE
+  start_emit_thread();
+#endif
+#ifdef IME_HENKAN_ENABLE
+  load_henkan_learned();
+#endif
+#ifdef IME_HEATMAP_ENABLE
+  load_heatmap();
+#endif
 }
 
 // --- Matrix scan (timeout) ---
 void ime_matrix_scan(void) {
-    if (recent[RECENT_SIZE - 1] && timer_expired(timer_read(), deadline)) {
-        clear_recent_keys();
+    count_reports();
+    if (recent_len && timer_expired(timer_read(), deadline)) {
+        abandon_recent_keys();
+        timed_out = true;
+    }
+#ifdef IME_HENKAN_ENABLE
+    if (henkan_state == HENKAN_WAITING && timer_expired(timer_read(), henkan_deadline)) {
+        henkan_host = false;  // stop asking until the helper says hello again
+        clear_snippet_keys();
+    }
+    flush_henkan_learned();
+#endif
+#ifdef IME_HEATMAP_ENABLE
+    snapshot_heatmap();
+#endif
+#ifdef IME_HOLD_ENABLE
+    check_held_key();
+#endif
+#ifdef IME_EMIT_THREAD_ENABLE
+    yield_to_emit_thread();
+#endif
+}
+
+// --- Romaji table ---
+// Each row carries one bit per profile that accepts the spelling plus one
+// bit per script it applies to, so every profile shares the same rows.
+#define R_PRM  (1 << ROMA_PERMISSIVE)
+#define R_HEP  (1 << ROMA_HEPBURN)
+#define R_KUN  (1 << ROMA_KUNREI)
+#define R_NIH  (1 << ROMA_NIHON)
+#define R_ALL  (R_PRM | R_HEP | R_KUN | R_NIH)
+#define R_HIRA (1 << 4)
+#define R_KATA (1 << 5)
+#define R_BOTH (R_HIRA | R_KATA)
+
+#define ROMA_MAX 4  // Longest key sequence in romaji.def
+
+typedef struct {
+  char     keys[ROMA_MAX];  // romaji, NUL padded
+  uint8_t  mask;            // R_* profile and script bits
+  uint16_t kana[2];         // hiragana codepoints, 0 padded
+} romaji_t;
+
+#define ROMA(keys, profiles, scripts, k1, k2) { keys, (profiles) | (scripts), { k1, k2 } },
+static const romaji_t PROGMEM romaji_table[] = {
+#include "romaji.def"
+};
+#undef ROMA
+
+enum { ROMA_NONE, ROMA_PREFIX, ROMA_EXACT };
+
+// Row numbers of romaji_table sorted by keys, built at boot. A lookup is a
+// binary search for the keys typed plus a walk over the rows they begin,
+// so romaji.def can list its rows in any order.
+static uint8_t romaji_order[ARRAY_SIZE(romaji_table)];
+
+_Static_assert(ARRAY_SIZE(romaji_table) <= UINT8_MAX, "romaji_order needs wider entries");
+
+static void romaji_keys(uint8_t row, char *keys) {
+  memcpy_P(keys, romaji_table[row].keys, ROMA_MAX);
+}
+
+static void sort_romaji_table(void) {
+  for (uint8_t i = 0; i < ARRAY_SIZE(romaji_table); i++) {
+    char    keys[ROMA_MAX], other[ROMA_MAX];
+    uint8_t j = i;
+    romaji_keys(i, keys);
+    for (; j > 0; j--) {  // insertion sort, once at boot
+      romaji_keys(romaji_order[j - 1], other);
+      if (strncmp(other, keys, ROMA_MAX) <= 0) { break; }
+      romaji_order[j] = romaji_order[j - 1];
+    }
+    romaji_order[j] = i;
+  }
+}
+
+// Codepoints for UM() keys, read by QMK for the marks and by the IME for
+// the rest, the romaji letter each IME key stands for, and what each key
+// gives with Shift.
+#define UKEY(name, codepoint, romaji, shifted) [name] = codepoint,
+#define UMARK(name, codepoint, shifted) [name] = codepoint,
+const uint32_t PROGMEM unicode_map[] = {
+#include "unicode.def"
+};
+#undef UKEY
+#undef UMARK
+
+#define UKEY(name, codepoint, romaji, shifted) [name] = romaji,
+#define UMARK(name, codepoint, shifted)
+static const char PROGMEM unicode_romaji[UNICODE_IME_KEYS] = {
+#include "unicode.def"
+};
+#undef UKEY
+#undef UMARK
+
+#define UKEY(name, codepoint, romaji, shifted) [name] = shifted,
+#define UMARK(name, codepoint, shifted) [name] = shifted,
+static const uint16_t PROGMEM unicode_shifted[UNICODE_KEYS] = {
+#include "unicode.def"
+};
+#undef UKEY
+#undef UMARK
+
+static uint16_t unicode_codepoint(uint16_t keycode) {
+  return pgm_read_dword(&unicode_map[QK_UNICODEMAP_GET_INDEX(keycode)]);
+}
+
+// Maps a kana-layer keycode onto the romaji letter it stands for, or 0.
+static char romaji_char(uint16_t keycode) {
+  switch (keycode) {
+    case KC_A ... KC_Z:
+      return 'a' + (keycode - KC_A);
+    case QK_UNICODEMAP ... QK_UNICODEMAP + UNICODE_IME_KEYS - 1:
+      return pgm_read_byte(&unicode_romaji[QK_UNICODEMAP_GET_INDEX(keycode)]);
+  }
+  return 0;
+}
+
+// Looks `len` keys of `seq` up in the table for the active profile and script.
+static uint8_t romaji_lookup(const char *seq, uint8_t len, romaji_t *hit) {
+  uint8_t want   = (1 << ime_config.romaji) | (IS_LAYER_ON(HIRAGANA) ? R_HIRA : R_KATA);
+  uint8_t result = ROMA_NONE;
+
+  if (len > ROMA_MAX) { return ROMA_NONE; }
+
+  // first row not sorting before `seq`; rows spelling `seq` exactly come
+  // ahead of the longer ones it begins
+  uint8_t lo = 0, hi = ARRAY_SIZE(romaji_table);
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) / 2;
+    char    keys[ROMA_MAX];
+    romaji_keys(romaji_order[mid], keys);
+    if (strncmp(keys, seq, len) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  for (; lo < ARRAY_SIZE(romaji_table); lo++) {
+    romaji_t row;
+    memcpy_P(&row, &romaji_table[romaji_order[lo]], sizeof(row));
+    if (strncmp(row.keys, seq, len) != 0) { break; }
+    if (!(row.mask & want & R_ALL) || !(row.mask & want & R_BOTH)) { continue; }
+    if (len == ROMA_MAX || row.keys[len] == '\0') {
+      *hit = row;
+      return ROMA_EXACT;
+    }
+    result = ROMA_PREFIX;
+  }
+  return result;
+}
+
+// A doubled consonant is the sokuon: っ followed by whatever the rest spells.
+static uint8_t romaji_match(const char *seq, uint8_t len, romaji_t *hit, bool *sokuon) {
+  *sokuon = len > 1 && seq[0] == seq[1] && seq[0] >= 'b' && seq[0] <= 'z' &&
+            !strchr("eionu", seq[0]);
+  if (*sokuon) {
+    seq++;
+    len--;
+  }
+  return romaji_lookup(seq, len, hit);
+}
+
+// --- Output scripts ---
+// Everything the IME types goes out through send_char, which widens or
+// narrows it for the script chosen with OUT_NEXT. Kana leaves it as it is.
+
+// Half-width katakana for U+30A0-30FF: U+FF60 plus the low 6 bits, then ﾞ
+// or ﾟ if HALF_VOICED or HALF_SEMI is set; 0 where there is none.
+#define HALF_CODE   0x3F
+#define HALF_VOICED 0x40
+#define HALF_SEMI   0x80
+
+static const uint8_t PROGMEM halfwidth_katakana[96] = {
+  0x00, 0x07, 0x11, 0x08, 0x12, 0x09, 0x13, 0x0A, 0x14, 0x0B, 0x15, 0x16, 0x56, 0x17, 0x57, 0x18,  // ゠ァアィイゥウェエォオカガキギク
+  0x58, 0x19, 0x59, 0x1A, 0x5A, 0x1B, 0x5B, 0x1C, 0x5C, 0x1D, 0x5D, 0x1E, 0x5E, 0x1F, 0x5F, 0x20,  // グケゲコゴサザシジスズセゼソゾタ
+  0x60, 0x21, 0x61, 0x0F, 0x22, 0x62, 0x23, 0x63, 0x24, 0x64, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A,  // ダチヂッツヅテデトドナニヌネノハ
+  0x6A, 0xAA, 0x2B, 0x6B, 0xAB, 0x2C, 0x6C, 0xAC, 0x2D, 0x6D, 0xAD, 0x2E, 0x6E, 0xAE, 0x2F, 0x30,  // バパヒビピフブプヘベペホボポマミ
+  0x31, 0x32, 0x33, 0x0C, 0x34, 0x0D, 0x35, 0x0E, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x00, 0x3C,  // ムメモャヤュユョヨラリルレロヮワ
+  0x00, 0x00, 0x06, 0x3D, 0x53, 0x00, 0x00, 0x7C, 0x00, 0x00, 0x46, 0x05, 0x10, 0x00, 0x00, 0x00,  // ヰヱヲンヴヵヶヷヸヹヺ・ーヽヾヿ
+};
+
+// The half-width code of a kana or kana mark, hiragana read as katakana.
+static uint8_t halfwidth_code(uint32_t codepoint) {
+  if (codepoint >= 0x3041 && codepoint <= 0x3096) {
+    codepoint += KTKN_A - HRGN_A;
+  }
+  if (codepoint >= 0x30A0 && codepoint <= 0x30FF) {
+    return pgm_read_byte(&halfwidth_katakana[codepoint - 0x30A0]);
+  }
+  switch (codepoint) {
+    case SYM_PERIOD: return 0x01;  // ｡
+    case SYM_KAKKO1: return 0x02;  // ｢
+    case SYM_KAKKO2: return 0x03;  // ｣
+    case SYM_COMMA: return 0x04;   // ､
+    case SYM_DAKUTEN:
+    case 0x309B: return 0x3E;      // ﾞ
+    case SYM_HANDAKUTEN:
+    case 0x309C: return 0x3F;      // ﾟ
+  }
+  return 0;
+}
+
+// Types one character in the output script. Returns how many it took on screen.
+static uint8_t send_char(uint32_t codepoint) {
+  last_kana = 0;
+  switch (ime_config.output) {
+  case OUT_FULLWIDTH:
+    if (codepoint >= 0x21 && codepoint <= 0x7E) {
+      codepoint += 0xFF01 - 0x21;
+    }
+    break;
+  case OUT_HALFWIDTH: {
+    uint8_t half = halfwidth_code(codepoint);
+    if (half) {
+      emit_unicode(0xFF60 + (half & HALF_CODE));
+      if (half & (HALF_VOICED | HALF_SEMI)) {
+        emit_unicode(half & HALF_VOICED ? 0xFF9E : 0xFF9F);
+        return 2;
+      }
+      return 1;
+    }
+    break;
+  }
+  }
+  emit_unicode(codepoint);
+  return 1;
+}
+
+// Characters the word took on screen, more than word_len where half-width
+// split off a voiced mark.
+static uint8_t word_width(void) {
+  uint8_t width = word_len;
+  if (ime_config.output == OUT_HALFWIDTH) {
+    for (uint8_t i = 0; i < MIN(word_len, HENKAN_MAX); i++) {
+      width += (halfwidth_code(word[i]) & (HALF_VOICED | HALF_SEMI)) != 0;
     }
+  }
+  return width;
+}
+
+static void add_to_word(uint16_t codepoint) {
+  if (word_len < HENKAN_MAX) {
+    if (codepoint >= 0x30A1 && codepoint <= 0x30F6) {
+      codepoint -= KTKN_A - HRGN_A;
+    }
+    word[word_len] = codepoint;
+  }
+  word_len++;
+}
+
+static void send_kana(uint16_t codepoint) {
+  if (!IS_LAYER_ON(HIRAGANA) && codepoint >= 0x3041 && codepoint <= 0x3096) {
+    codepoint += KTKN_A - HRGN_A;
+  }
+  send_char(codepoint);
+  add_to_word(codepoint);
+  last_kana = codepoint;
+  if (!recent_shown) {
+    ime_stats.kana++;  // one typed ahead of a match is counted if it stays
+  }
+}
+
+// Kana that take a voiced mark, as hiragana; katakana is looked up the same way
+typedef struct {
+  uint16_t kana;
+  uint16_t dakuten;     // precomposed with ゛
+  uint16_t handakuten;  // with ゜, or 0
+} voiced_kana_t;
+
+static const voiced_kana_t PROGMEM voiced_table[] = {
+  { 0x3046, 0x3094, 0      },  // う ゔ
+  { 0x304B, 0x304C, 0      },  // か が
+  { 0x304D, 0x304E, 0      },  // き ぎ
+  { 0x304F, 0x3050, 0      },  // く ぐ
+  { 0x3051, 0x3052, 0      },  // け げ
+  { 0x3053, 0x3054, 0      },  // こ ご
+  { 0x3055, 0x3056, 0      },  // さ ざ
+  { 0x3057, 0x3058, 0      },  // し じ
+  { 0x3059, 0x305A, 0      },  // す ず
+  { 0x305B, 0x305C, 0      },  // せ ぜ
+  { 0x305D, 0x305E, 0      },  // そ ぞ
+  { 0x305F, 0x3060, 0      },  // た だ
+  { 0x3061, 0x3062, 0      },  // ち ぢ
+  { 0x3064, 0x3065, 0      },  // つ づ
+  { 0x3066, 0x3067, 0      },  // て で
+  { 0x3068, 0x3069, 0      },  // と ど
+  { 0x306F, 0x3070, 0x3071 },  // は ば ぱ
+  { 0x3072, 0x3073, 0x3074 },  // ひ び ぴ
+  { 0x3075, 0x3076, 0x3077 },  // ふ ぶ ぷ
+  { 0x3078, 0x3079, 0x307A },  // へ べ ぺ
+  { 0x307B, 0x307C, 0x307D },  // ほ ぼ ぽ
+};
+
+// Puts the ゛ or ゜ of `keycode` onto the kana just typed by typing its
+// precomposed form over it, in the word too. Returns false if the key is
+// no such mark or the kana has no such form, for the combining mark.
+static bool fold_voiced_mark(uint16_t keycode) {
+  if (!last_kana || !IS_IME_UNICODE(keycode)) { return false; }
+  uint16_t mark = unicode_codepoint(keycode);
+  if (mark != SYM_DAKUTEN && mark != SYM_HANDAKUTEN) { return false; }
+
+  uint16_t kana  = last_kana;
+  uint16_t shift = kana >= 0x30A1 && kana <= 0x30F6 ? KTKN_A - HRGN_A : 0;  // keep its script
+  for (uint8_t i = 0; i < ARRAY_SIZE(voiced_table); i++) {
+    voiced_kana_t row;
+    memcpy_P(&row, &voiced_table[i], sizeof(row));
+    if (row.kana != kana - shift) { continue; }
+    uint16_t voiced = mark == SYM_DAKUTEN ? row.dakuten : row.handakuten;
+    if (!voiced) { return false; }
+    tap_backspace();
+    send_char(voiced + shift);
+    if (word_len > 0 && word_len <= HENKAN_MAX) {
+      word[word_len - 1] = voiced;
+    }
+    last_kana = voiced + shift;
+    return true;
+  }
+  return false;
+}
+
+// Gives up on the pending sequence without losing keys: the consonants held
+// back are typed as the letters they were, after any kana keys of it
+// already on screen.
+static void flush_recent_keys(void) {
+  if (recent_len > recent_shown) {
+    for (uint8_t i = recent_shown; i < recent_len; i++) {
+      emit_tap(KC_A + recent[i] - 'a');
+    }
+    last_kana = 0;
+    if (snip_len > 0 && snip_len <= SNIP_MAX) {
+      snip_shown += word_width() + recent_len - recent_shown;  // a trigger still takes them back
+    }
+    word_len = 0;  // a reading can't run across the letters
+  }
+  abandon_recent_keys();
 }
 
-// Handles one event. Returns true if the key was appended to `recent`.
+// Feeds one romaji key into `recent`. Returns true if QMK should still type the key.
+static bool compose_recent_keys(char c, uint16_t keycode) {
+  romaji_t hit;
+  bool     sokuon;
+
+  recent[recent_len] = c;
+  switch (romaji_match(recent, recent_len + 1, &hit, &sokuon)) {
+  case ROMA_EXACT:
+    // kana typed ahead of the match (ん, 一, え) get replaced
+    for (; recent_shown > 0; recent_shown--) {
+      tap_backspace();
+      word_len--;
+    }
+    if (sokuon) {
+      send_kana(HRGN_TSU_SM);
+    }
+    for (uint8_t i = 0; i < ARRAY_SIZE(hit.kana) && hit.kana[i]; i++) {
+      send_kana(hit.kana[i]);
+    }
+    clear_recent_keys();
+    return false;
+  case ROMA_PREFIX:
+    // consonants are held back, kana keys show up right away
+    recent_len++;
+    if (IS_IME_UNICODE(keycode)) {
+      recent_shown++;
+      return true;
+    }
+    return false;
+  }
+
+  recent[recent_len] = '\0';
+  if (recent_len == 0) {
+    return true;
+  }
+  // any unmatched sequence is given up, its held-back consonants typed as
+  // letters, and the key starts the next one (ん followed by k, 一 by 二)
+  flush_recent_keys();
+  return compose_recent_keys(c, keycode);
+}
+
+// --- Snippets ---
+// Triggers are hashed into a RAM index at boot; while typing, the hash is
+// carried along key by key, so Space costs one probe to expand a trigger.
+// Built-ins come from snippets.def; user snippets from the EEPROM log below.
+#define SNIP_OFF 0xFF
+
+typedef struct {
+  char           trigger[SNIP_MAX];  // romaji, NUL padded
+  const uint8_t *phrase;             // kanapack string, in PROGMEM
+} snippet_t;
+
+#include "snippets.h"  // snip_<name>[], packed from snippets.def
+
+#define SNIP(name, trigger, phrase) { trigger, snip_##name },
+static const snippet_t PROGMEM snippet_table[] = {
+#include "snippets.def"
+};
+#undef SNIP
+
+// snip_index values: 0 empty, SNIP_GONE deleted, SNIP_USER | log offset,
+// otherwise built-in table position + 1
+#define SNIP_GONE 0xFFFF
+#define SNIP_USER 0x8000
+
+static uint16_t snip_index[SNIP_SLOTS];
+static uint32_t snip_first;  // letters a-z that start some trigger
+
+// User snippets live in the user EEPROM datablock as an append-only log:
+//   magic(2) { len, trigger_len, trigger..., phrase... }* 0
+// An edit appends a record, a delete appends one with no phrase, and the
+// record's length byte is written last so a torn append is never seen.
+// Deleting a user snippet that overrides a built-in brings the built-in
+// back; deleting that removes it until the trigger is added again.
+// Dead records are only squeezed out when the log runs full, so each
+// edit costs the flash just the bytes of its own record. Compaction can't
+// be made atomic in place; a power loss during it keeps the records it has
+// moved and loses the live ones after them.
+#define SNIP_LOG_MAGIC 0x4E53
+#define SNIP_LOG_START 2
+#define SNIP_RECORD_MAX (2 + SNIP_MAX + SNIP_PHRASE_MAX)
+
+static uint16_t snip_log_end;  // offset of the terminating 0
+static char     snip_stage[SNIP_MAX + SNIP_PHRASE_MAX];  // record uploaded over raw HID
+static uint8_t  snip_stage_trigger = 0;
+static uint8_t  snip_stage_len = 0;
+
+static uint8_t log_read(uint16_t pos) {
+  uint8_t b;
+  eeconfig_read_user_datablock(&b, SNIP_LOG_OFFSET + pos, 1);
+  return b;
+}
+
+static void log_write(uint16_t pos, const void *data, uint16_t len) {
+  eeconfig_update_user_datablock(data, SNIP_LOG_OFFSET + pos, len);
+}
+
+static uint16_t snippet_hash(uint16_t hash, char c) {
+  return (hash << 5) - hash + c;
+}
+
+// Fetches the trigger of an index entry into `trigger`, NUL padded.
+static void snippet_trigger(uint16_t entry, char *trigger) {
+  memset(trigger, 0, SNIP_MAX);
+  if (entry & SNIP_USER) {
+    uint16_t pos = entry & ~SNIP_USER;
+    uint8_t  len = MIN(log_read(pos + 1), SNIP_MAX);
+    for (uint8_t i = 0; i < len; i++) {
+      trigger[i] = log_read(pos + 2 + i);
+    }
+  } else {
+    memcpy_P(trigger, snippet_table[entry - 1].trigger, SNIP_MAX);
+  }
+}
+
+static bool same_trigger(const char *found, const char *trigger, uint8_t len) {
+  return strncmp(found, trigger, len) == 0 && (len == SNIP_MAX || found[len] == '\0');
+}
+
+// Finds the slot holding `trigger`, whose snippet_hash is `hash`, or else
+// the slot to put it in: the first deleted one its probe passed, so deletes
+// don't use the index up, or the empty slot ending the probe.
+static uint8_t probe_snippet(const char *trigger, uint8_t len, uint16_t hash) {
+  uint8_t slot = hash & (SNIP_SLOTS - 1);
+  uint8_t gone = SNIP_SLOTS;
+  for (uint8_t n = 0; n < SNIP_SLOTS && snip_index[slot]; n++) {
+    char found[SNIP_MAX];
+    if (snip_index[slot] == SNIP_GONE) {
+      if (gone == SNIP_SLOTS) { gone = slot; }
+    } else {
+      snippet_trigger(snip_index[slot], found);
+      if (same_trigger(found, trigger, len)) { return slot; }
+    }
+    slot = (slot + 1) & (SNIP_SLOTS - 1);
+  }
+  return gone < SNIP_SLOTS ? gone : slot;
+}
+
+static uint8_t snippet_slot(const char *trigger, uint8_t len) {
+  uint16_t hash = 0;
+  for (uint8_t i = 0; i < len; i++) {
+    hash = snippet_hash(hash, trigger[i]);
+  }
+  return probe_snippet(trigger, len, hash);
+}
+
+// Table position + 1 of the built-in snippet for `trigger`, 0 if none.
+static uint16_t builtin_snippet(const char *trigger, uint8_t len) {
+  for (uint8_t i = 0; i < ARRAY_SIZE(snippet_table); i++) {
+    char found[SNIP_MAX];
+    snippet_trigger(i + 1, found);
+    if (same_trigger(found, trigger, len)) { return i + 1; }
+  }
+  return 0;
+}
+
+// What deleting `trigger` leaves in its slot: the built-in a user snippet
+// overrode, else SNIP_GONE.
+static uint16_t deleted_snippet(const char *trigger, uint8_t len) {
+  uint16_t entry = snip_index[snippet_slot(trigger, len)];
+  if (entry != SNIP_GONE && (entry & SNIP_USER)) {
+    uint16_t builtin = builtin_snippet(trigger, len);
+    if (builtin) { return builtin; }
+  }
+  return SNIP_GONE;
+}
+
+// Keeps one slot free so every probe terminates.
+static bool snippet_index_full(void) {
+  uint8_t used = 0;
+  for (uint8_t i = 0; i < SNIP_SLOTS; i++) {
+    used += snip_index[i] != 0;
+  }
+  return used >= SNIP_SLOTS - 1;
+}
+
+// Points `trigger` at `entry`, SNIP_GONE to delete. Returns false if the index is full.
+static bool index_snippet(const char *trigger, uint8_t len, uint16_t entry) {
+  uint8_t slot = snippet_slot(trigger, len);
+  if (entry == SNIP_GONE && (!snip_index[slot] || snip_index[slot] == SNIP_GONE)) {
+    return true;  // nothing to delete
+  }
+  if (!snip_index[slot] && snippet_index_full()) { return false; }
+  if (entry != SNIP_GONE) {
+    snip_first |= 1UL << (trigger[0] - 'a');
+  }
+  snip_index[slot] = entry;
+  return true;
+}
+
+static void build_snippet_index(void) {
+  memset(snip_index, 0, sizeof(snip_index));
+  snip_first = 0;
+  for (uint8_t i = 0; i < ARRAY_SIZE(snippet_table); i++) {
+    char trigger[SNIP_MAX];
+    snippet_trigger(i + 1, trigger);
+    index_snippet(trigger, strnlen(trigger, SNIP_MAX), i + 1);
+  }
+
+  uint16_t magic;
+  eeconfig_read_user_datablock(&magic, SNIP_LOG_OFFSET, sizeof(magic));
+  if (magic != SNIP_LOG_MAGIC) {
+    uint8_t end = 0;
+    magic = SNIP_LOG_MAGIC;
+    log_write(SNIP_LOG_START, &end, 1);
+    log_write(0, &magic, sizeof(magic));
+  }
+
+  // replay the log; later records win
+  uint16_t pos = SNIP_LOG_START;
+  uint8_t  len;
+  while ((len = log_read(pos)) && pos + len < SNIP_LOG_SIZE) {
+    char    trigger[SNIP_MAX];
+    uint8_t trigger_len = log_read(pos + 1);
+    if (len < 2 + trigger_len || len > SNIP_RECORD_MAX || trigger_len == 0 || trigger_len > SNIP_MAX) {
+      break;  // torn or foreign data
+    }
+    snippet_trigger(SNIP_USER | pos, trigger);
+    if (trigger[0] < 'a' || trigger[0] > 'z') { break; }
+    index_snippet(trigger, trigger_len, len > 2 + trigger_len ? SNIP_USER | pos : deleted_snippet(trigger, trigger_len));
+    pos += len;
+  }
+  snip_log_end = pos;
+}
+
+// Drops superseded records by sliding live ones down over them. The log is
+// cut at the first dead record, and each live record after it is written
+// back behind a new end marker with its length byte last, so at every step
+// the log on flash is the records moved so far. The index follows each
+// move, so it never points into bytes already overwritten. A built-in that
+// is not in the index any more keeps the first delete record naming it,
+// which replays ahead of any user snippet added after it.
+static void compact_snippet_log(void) {
+  uint16_t to  = SNIP_LOG_START;
+  uint16_t pos = SNIP_LOG_START;
+  uint8_t  end = 0;
+  bool     builtin_deleted[ARRAY_SIZE(snippet_table)] = {false};  // a delete record kept for it
+  while (pos < snip_log_end) {
+    char     trigger[SNIP_MAX];
+    uint8_t  record[SNIP_RECORD_MAX];
+    uint8_t  len         = log_read(pos);
+    uint8_t  trigger_len = log_read(pos + 1);
+    bool     deleting    = len == 2 + trigger_len;
+    uint16_t builtin     = 0;
+    uint8_t  slot;
+    bool     live;
+    snippet_trigger(SNIP_USER | pos, trigger);
+    slot = snippet_slot(trigger, trigger_len);
+    if (deleting) {
+      builtin = builtin_snippet(trigger, trigger_len);
+      live    = builtin && !builtin_deleted[builtin - 1] && snip_index[slot] != builtin;
+      if (live) {
+        builtin_deleted[builtin - 1] = true;
+      }
+    } else {
+      live = snip_index[slot] == (SNIP_USER | pos);
+    }
+    if (!live) {
+      if (to == pos) {
+        log_write(to, &end, 1);  // cut
+      }
+    } else if (to == pos) {
+      to += len;  // nothing dead before it yet
+    } else {
+      eeconfig_read_user_datablock(record, SNIP_LOG_OFFSET + pos, len);
+      log_write(to + 1, record + 1, len - 1);
+      log_write(to + len, &end, 1);
+      log_write(to, &len, 1);  // commit
+      if (!deleting) {
+        snip_index[slot] = SNIP_USER | to;
+      }
+      to += len;
+    }
+    pos += len;
+  }
+  build_snippet_index();
+}
+
+// Whether the index has a slot for the staged trigger, if it needs a new one.
+static bool room_for_staged_snippet(void) {
+  return snip_index[snippet_slot(snip_stage, snip_stage_trigger)] || !snippet_index_full();
+}
+
+// Appends the staged record to the log. Returns false if it cannot fit.
+static bool append_snippet(void) {
+  uint8_t len  = 2 + snip_stage_len;
+  bool    gone = snip_stage_len == snip_stage_trigger;
+  if (snip_stage_trigger == 0 || snip_stage[0] < 'a' || snip_stage[0] > 'z') { return false; }
+  if (gone) {
+    uint16_t entry = snip_index[snippet_slot(snip_stage, snip_stage_trigger)];
+    if (!entry || entry == SNIP_GONE) { return true; }  // nothing to delete, nothing to log
+  } else if (!room_for_staged_snippet()) {
+    compact_snippet_log();  // the markers of deleted user snippets go with their records
+    if (!room_for_staged_snippet()) { return false; }
+  }
+  if (snip_log_end + len >= SNIP_LOG_SIZE) {
+    compact_snippet_log();
+    if (snip_log_end + len >= SNIP_LOG_SIZE) { return false; }
+  }
+
+  uint8_t  end = 0;
+  uint16_t pos = snip_log_end;
+  log_write(pos + 1, &snip_stage_trigger, 1);
+  log_write(pos + 2, snip_stage, snip_stage_len);
+  log_write(pos + len, &end, 1);
+  log_write(pos, &len, 1);  // commit
+
+  snip_log_end = pos + len;
+  return index_snippet(snip_stage, snip_stage_trigger,
+                       gone ? deleted_snippet(snip_stage, snip_stage_trigger) : SNIP_USER | pos);
+}
+
+static void clear_snippet_keys(void) {
+  snip_len = 0;
+  snip_hash = 0;
+  snip_shown = 0;
+  word_len = 0;
+#ifdef IME_HENKAN_ENABLE
+  settle_henkan();
+#endif
+}
+
+// Folds one romaji key into the running trigger; any other key is a word boundary.
+static void update_snippet_keys(char c) {
+  if (!c) {
+    clear_snippet_keys();
+    return;
+  }
+  if (snip_len == 0 && (c < 'a' || c > 'z' || !(snip_first & (1UL << (c - 'a'))))) {
+    snip_len = SNIP_OFF;  // no trigger starts here, stay out of the way until the boundary
+  }
+  if (snip_len >= SNIP_MAX) {
+    snip_len = SNIP_OFF;
+    return;
+  }
+  snip_keys[snip_len++] = c;
+  snip_hash = snippet_hash(snip_hash, c);
+}
+
+// --- Packed strings ---
+// Large text tables are kept in the 6-bit code of host/kanapack.py and
+// decoded straight into send_char, with no RAM copy of the text.
+typedef struct {
+  const uint8_t *next;   // PROGMEM
+  uint32_t       bits;   // unread bits, right aligned
+  uint8_t        nbits;
+} kana_reader_t;
+
+static uint16_t read_kana_bits(kana_reader_t *reader, uint8_t width) {
+  while (reader->nbits < width) {
+    reader->bits = (reader->bits << 8) | pgm_read_byte(reader->next++);
+    reader->nbits += 8;
+  }
+  reader->nbits -= width;
+  return (reader->bits >> reader->nbits) & ((1UL << width) - 1);
+}
+
+// Returns the next codepoint of a packed string, 0 at its end.
+static uint16_t read_kana(kana_reader_t *reader, bool *katakana) {
+  for (;;) {
+    uint16_t codepoint;
+    uint8_t  symbol = read_kana_bits(reader, 6);
+    if (symbol == 0) {
+      return 0;
+    } else if (symbol == KANA_ESCAPE) {
+      return read_kana_bits(reader, 16);
+    } else if (symbol == KANA_SHIFT) {
+      codepoint = pgm_read_word(&kana_secondary[read_kana_bits(reader, 6)]);
+      if (codepoint == KANA_KATAKANA) {
+        *katakana = !*katakana;
+        continue;
+      }
+    } else {
+      codepoint = pgm_read_word(&kana_primary[symbol - 1]);
+    }
+    if (*katakana && codepoint >= 0x3041 && codepoint <= 0x3096) {
+      codepoint += KTKN_A - HRGN_A;
+    }
+    return codepoint;
+  }
+}
+
+static void send_packed_P(const uint8_t *packed) {
+  kana_reader_t reader   = { packed, 0, 0 };
+  bool          katakana = false;
+  uint16_t      codepoint;
+  while ((codepoint = read_kana(&reader, &katakana))) {
+    send_char(codepoint);
+  }
+}
+
+// Feeds phrase bytes one at a time, sending each codepoint as it completes.
+// Returns the characters that put on screen.
+static uint8_t send_utf8_byte(uint8_t b) {
+  static uint32_t codepoint = 0;
+  static uint8_t  more      = 0;
+
+  if (more && (b & 0xC0) == 0x80) {
+    codepoint = (codepoint << 6) | (b & 0x3F);
+    return --more == 0 ? send_char(codepoint) : 0;
+  }
+  if (b >= 0xF0) {
+    codepoint = b & 0x07;
+    more      = 3;
+  } else if (b >= 0xE0) {
+    codepoint = b & 0x0F;
+    more      = 2;
+  } else if (b >= 0xC0) {
+    codepoint = b & 0x1F;
+    more      = 1;
+  } else {
+    more = 0;
+    return send_char(b);
+  }
+  return 0;
+}
+
+// Expands the trigger typed since the last boundary. Returns false if there is none.
+static bool send_snippet(void) {
+  if (snip_len == 0 || snip_len > SNIP_MAX) { return false; }
+
+  uint8_t  slot  = probe_snippet(snip_keys, snip_len, snip_hash);
+  uint16_t entry = snip_index[slot];
+  if (!entry || entry == SNIP_GONE) { return false; }
+
+  // take back what the trigger put on screen; held consonants are dropped
+  for (uint8_t i = snip_shown + word_width(); i > 0; i--) {
+    tap_backspace();
+  }
+  word_len = 0;
+  clear_recent_keys();
+
+  if (entry & SNIP_USER) {
+    uint16_t pos = entry & ~SNIP_USER;
+    uint8_t  len = log_read(pos);
+    for (uint16_t i = 2 + log_read(pos + 1); i < len; i++) {
+      send_utf8_byte(log_read(pos + i));
+    }
+  } else {
+    send_packed_P((const uint8_t *)pgm_read_ptr(&snippet_table[entry - 1].phrase));
+  }
+  clear_snippet_keys();
+  return true;
+}
+
+#ifdef IME_HENKAN_ENABLE
+// --- Henkan ---
+// henkan.dic is packed into flash by host/kanapack.py as records sorted by
+// reading. A binary search over henkan_index, which samples every
+// HENKAN_STRIDE-th record, narrows a lookup to one run that is then scanned.
+#include "henkan.h"
+
+// Compares the reading heading `record` with `word`, like strcmp.
+static int8_t henkan_compare(const uint8_t *record) {
+  kana_reader_t reader   = { record + 1, 0, 0 };
+  bool          katakana = false;
+
+  for (uint8_t i = 0;; i++) {
+    uint16_t have = read_kana(&reader, &katakana);
+    uint16_t want = i < word_len ? word[i] : 0;
+    if (have != want) { return have < want ? -1 : 1; }
+    if (!have) { return 0; }
+  }
+}
+
+static const uint8_t *henkan_lookup(void) {
+  uint16_t lo = 0, hi = ARRAY_SIZE(henkan_index);
+
+  // the last sample not past the word starts its run
+  while (hi - lo > 1) {
+    uint16_t mid = (lo + hi) / 2;
+    if (henkan_compare(henkan_data + pgm_read_word(&henkan_index[mid])) <= 0) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  const uint8_t *record = henkan_data + pgm_read_word(&henkan_index[lo]);
+  for (uint16_t i = lo * HENKAN_STRIDE; i < HENKAN_ENTRIES && i < (lo + 1) * HENKAN_STRIDE; i++) {
+    int8_t order = henkan_compare(record);
+    if (order == 0) { return record; }
+    if (order > 0) { break; }
+    record += pgm_read_byte(record);
+  }
+  return NULL;
+}
+
+// --- Henkan learning ---
+// The candidate last chosen for a reading, when it is not the first, is
+// kept in a short most-recent-first list and shown straight away the next
+// time. Changes reach EEPROM as one batch, HENKAN_LEARN_FLUSH_MS after the
+// first of them, so choosing a word costs no write of its own.
+#define HENKAN_LEARN_MAGIC 0x4C48
+
+typedef struct {
+  uint16_t hash;  // of the reading
+  uint8_t  cand;  // 0 for an empty slot
+} henkan_learned_t;
+
+static henkan_learned_t henkan_learned[HENKAN_LEARN_SLOTS];
+static bool             henkan_learned_dirty = false;
+static uint16_t         henkan_learned_deadline;
+
+_Static_assert(sizeof(uint16_t) + sizeof(henkan_learned) <= HENKAN_LEARN_SIZE, "HENKAN_LEARN_SIZE too small");
+
+static void load_henkan_learned(void) {
+  uint16_t magic;
+  eeconfig_read_user_datablock(&magic, HENKAN_LEARN_OFFSET, sizeof(magic));
+  if (magic == HENKAN_LEARN_MAGIC) {
+    eeconfig_read_user_datablock(henkan_learned, HENKAN_LEARN_OFFSET + sizeof(magic), sizeof(henkan_learned));
+  } else {
+    memset(henkan_learned, 0, sizeof(henkan_learned));
+  }
+}
+
+static void flush_henkan_learned(void) {
+  if (!henkan_learned_dirty || !timer_expired(timer_read(), henkan_learned_deadline)) { return; }
+  uint16_t magic = HENKAN_LEARN_MAGIC;
+  eeconfig_update_user_datablock(henkan_learned, HENKAN_LEARN_OFFSET + sizeof(magic), sizeof(henkan_learned));
+  eeconfig_update_user_datablock(&magic, HENKAN_LEARN_OFFSET, sizeof(magic));
+  henkan_learned_dirty = false;
+}
+
+static uint8_t find_henkan_learned(uint16_t hash) {
+  uint8_t i = 0;
+  while (i < HENKAN_LEARN_SLOTS && !(henkan_learned[i].cand && henkan_learned[i].hash == hash)) {
+    i++;
+  }
+  return i;
+}
+
+// Notes `cand` as the choice for `hash`, at the front of the list.
+static void learn_henkan(uint16_t hash, uint8_t cand) {
+  uint8_t i = find_henkan_learned(hash);
+
+  if (cand <= 1) {  // the first candidate needs no note, so choosing it drops any earlier one
+    if (i == HENKAN_LEARN_SLOTS) { return; }
+    memmove(&henkan_learned[i], &henkan_learned[i + 1], (HENKAN_LEARN_SLOTS - 1 - i) * sizeof(henkan_learned[0]));
+    henkan_learned[HENKAN_LEARN_SLOTS - 1].cand = 0;
+  } else {
+    if (i == 0 && henkan_learned[0].cand == cand) { return; }
+    if (i == HENKAN_LEARN_SLOTS) {
+      i--;  // the least recent goes
+    }
+    memmove(&henkan_learned[1], &henkan_learned[0], i * sizeof(henkan_learned[0]));
+    henkan_learned[0] = (henkan_learned_t){ hash, cand };
+  }
+  if (!henkan_learned_dirty) {
+    henkan_learned_dirty    = true;
+    henkan_learned_deadline = timer_read() + HENKAN_LEARN_FLUSH_MS;
+  }
+}
+
+// Types candidate `cand` of the flash entry, or the reading once the
+// candidates run out. Returns the characters typed.
+static uint8_t send_flash_candidate(uint8_t *cand) {
+  kana_reader_t reader = { henkan_record + 1, 0, 0 };
+  bool          katakana;
+  uint16_t      codepoint;
+  uint8_t       shown = 0;
+
+  uint8_t i = 0;
+  for (; i < *cand; i++) {  // skip the reading and earlier candidates
+    katakana = false;
+    if (!read_kana(&reader, &katakana)) { break; }  // the "" ending the record
+    while (read_kana(&reader, &katakana)) {}
+  }
+  katakana  = false;
+  codepoint = i == *cand ? read_kana(&reader, &katakana) : 0;
+  if (!codepoint) {
+    *cand     = 0;
+    reader    = (kana_reader_t){ henkan_record + 1, 0, 0 };
+    codepoint = read_kana(&reader, &katakana);
+  }
+  if (!*cand) {
+    katakana = !IS_LAYER_ON(HIRAGANA);  // the reading goes back as it was typed
+  }
+
+  for (; codepoint; codepoint = read_kana(&reader, &katakana)) {
+    if (katakana && codepoint >= 0x3041 && codepoint <= 0x3096) {
+      codepoint += KTKN_A - HRGN_A;
+    }
+    shown += send_char(codepoint);
+  }
+  return shown;
+}
+
+// As above, from the helper's answer in henkan_remote.
+static uint8_t send_remote_candidate(uint8_t *cand) {
+  const char *text  = henkan_remote;
+  uint8_t     shown = 0;
+
+  for (uint8_t i = 0; i < *cand && (i == 0 || *text); i++) {  // not past the ""
+    text += strlen(text) + 1;
+  }
+  if (!*text) {
+    *cand = 0;
+    text  = henkan_remote;
+  }
+  for (; *text; text++) {
+    shown += send_utf8_byte(*text);
+  }
+  return shown;
+}
+
+// Replaces the conversion on screen with candidate `cand`. Backspaces and
+// text go out in one pass.
+static void send_henkan(uint8_t cand) {
+  for (; henkan_shown > 0; henkan_shown--) {
+    tap_backspace();
+  }
+  henkan_shown = henkan_state == HENKAN_REMOTE ? send_remote_candidate(&cand)
+                                               : send_flash_candidate(&cand);
+  henkan_cand  = cand;
+}
+
+// Candidates of the entry being converted, not counting the reading.
+static uint8_t count_henkan_candidates(void) {
+  uint8_t count = 0;
+  if (henkan_state == HENKAN_REMOTE) {
+    for (const char *text = henkan_remote + strlen(henkan_remote) + 1; *text; text += strlen(text) + 1) {
+      count++;
+    }
+  } else {
+    kana_reader_t reader   = { henkan_record + 1, 0, 0 };
+    bool          katakana = false;
+    while (read_kana(&reader, &katakana)) {}  // the reading
+    for (; read_kana(&reader, &katakana); count++) {
+      while (read_kana(&reader, &katakana)) {}
+    }
+  }
+  return count;
+}
+
+// Shows the candidate learned for the reading, else the first.
+static void start_henkan(void) {
+  uint8_t i    = find_henkan_learned(henkan_hash);
+  uint8_t cand = i < HENKAN_LEARN_SLOTS ? henkan_learned[i].cand : 1;
+  if (cand > count_henkan_candidates()) {
+    // learned from an older dictionary, or for another reading with the
+    // same hash: the note goes
+    learn_henkan(henkan_hash, 1);
+    cand = 1;
+  }
+  send_henkan(cand);
+}
+
+// Ends the conversion, keeping what is on screen.
+static void settle_henkan(void) {
+  if (henkan_state == HENKAN_WAITING) {
+    emit_tap(KC_SPC);  // no candidates came, so the Space that asked is typed after all
+    last_kana = 0;
+  } else if (henkan_state != HENKAN_OFF && henkan_cand) {
+    learn_henkan(henkan_hash, henkan_cand);
+  }
+  henkan_state = HENKAN_OFF;
+}
+
+static uint8_t put_utf8(uint16_t codepoint, char *out) {
+  if (codepoint < 0x80) {
+    out[0] = codepoint;
+    return 1;
+  } else if (codepoint < 0x800) {
+    out[0] = 0xC0 | (codepoint >> 6);
+    out[1] = 0x80 | (codepoint & 0x3F);
+    return 2;
+  }
+  out[0] = 0xE0 | (codepoint >> 12);
+  out[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+  out[2] = 0x80 | (codepoint & 0x3F);
+  return 3;
+}
+
+// Sends `word` to the host helper as [IME_HID_HENKAN_QUERY, seq, len, UTF-8
+// hiragana]. The answer arrives through ime_raw_hid_receive; queries are
+// not waited on, so the helper may have several in flight and only the
+// answer to the latest is used.
+static void query_henkan(void) {
+  uint8_t report[IME_HID_REPORT_SIZE] = { IME_HID_HENKAN_QUERY, ++henkan_seq };
+  uint8_t len = 0;
+
+  henkan_remote_len = 0;
+  for (uint8_t i = 0; i < word_len; i++) {
+    uint16_t codepoint = word[i];
+    len += put_utf8(codepoint, (char *)report + 3 + len);
+    if (!IS_LAYER_ON(HIRAGANA) && codepoint >= 0x3041 && codepoint <= 0x3096) {
+      codepoint += KTKN_A - HRGN_A;
+    }
+    henkan_remote_len += put_utf8(codepoint, henkan_remote + henkan_remote_len);
+  }
+  henkan_remote[henkan_remote_len++] = '\0';  // the reading is candidate 0
+  report[2] = len;
+  raw_hid_send(report, sizeof(report));
+}
+
+// Appends a chunk of the helper's answer to query `seq`.
+static void receive_henkan(uint8_t seq, const uint8_t *data, uint8_t len) {
+  if (henkan_state != HENKAN_WAITING || seq != henkan_seq) { return; }
+  len = MIN(len, HENKAN_REMOTE_SIZE - 1 - henkan_remote_len);  // keep room for the last ""
+  memcpy(henkan_remote + henkan_remote_len, data, len);
+  henkan_remote_len += len;
+}
+
+// Shows the first candidate of a complete answer to query `seq`.
+static void finish_henkan(uint8_t seq) {
+  if (henkan_state != HENKAN_WAITING || seq != henkan_seq) { return; }
+  // drop any candidate cut short by the buffer
+  while (henkan_remote[henkan_remote_len - 1] != '\0') {
+    henkan_remote_len--;
+  }
+  henkan_remote[henkan_remote_len] = '\0';
+  if (henkan_remote_len == strlen(henkan_remote) + 1) {
+    clear_snippet_keys();  // none found
+    return;
+  }
+  henkan_state = HENKAN_REMOTE;
+  start_henkan();
+}
+
+// Space converts the word just typed, then steps through its candidates.
+// Any other key keeps the candidate on screen; Escape puts the reading back.
+// Returns false if the key was used up.
+static bool process_henkan(uint16_t keycode) {
+  switch (henkan_state) {
+  case HENKAN_FLASH:
+  case HENKAN_REMOTE:
+    if (keycode == KC_SPC) {
+      send_henkan(henkan_cand + 1);
+      return false;
+    }
+    if (keycode == KC_ESC) {
+      send_henkan(0);
+    }
+    settle_henkan();
+    return keycode != KC_ESC;
+  case HENKAN_WAITING:
+    clear_snippet_keys();  // typing on gives up on the answer
+    return true;
+  }
+  if (keycode != KC_SPC || word_len == 0 || word_len > HENKAN_MAX) { return true; }
+
+  const uint8_t *record = henkan_lookup();
+  if (!record && !henkan_host) { return true; }
+  henkan_shown = word_width();
+  henkan_hash  = 0;
+  for (uint8_t i = 0; i < word_len; i++) {
+    henkan_hash = henkan_hash * 31 + word[i];
+  }
+  clear_recent_keys();  // held consonants are dropped
+  if (record) {
+    clear_snippet_keys();
+    henkan_record = record;
+    henkan_state  = HENKAN_FLASH;
+    start_henkan();
+  } else {
+    query_henkan();
+    clear_snippet_keys();
+    henkan_state    = HENKAN_WAITING;
+    henkan_deadline = timer_read() + HENKAN_HOST_TIMEOUT_MS;
+  }
+  return false;
+}
+#endif
+
+// --- Raw HID ---
+void ime_raw_hid_receive(uint8_t *data, uint8_t length) {
+  uint8_t len    = data[1];
+  uint8_t status = IME_HID_OK;
+
+  switch (data[0]) {
+  case IME_HID_SNIP_BEGIN:  // [cmd, trigger_len, trigger...]
+    if (len == 0 || len > SNIP_MAX || len > length - 2) {
+      status = IME_HID_ERROR;
+      break;
+    }
+    memcpy(snip_stage, data + 2, len);
+    snip_stage_trigger = snip_stage_len = len;
+    break;
+  case IME_HID_SNIP_DATA:  // [cmd, chunk_len, UTF-8 phrase bytes...]
+    if (!snip_stage_trigger || len > length - 2 ||
+        snip_stage_len + len > snip_stage_trigger + SNIP_PHRASE_MAX) {
+      status = IME_HID_ERROR;
+      break;
+    }
+    memcpy(snip_stage + snip_stage_len, data + 2, len);
+    snip_stage_len += len;
+    break;
+  case IME_HID_SNIP_COMMIT:  // [cmd]; an empty phrase deletes the trigger
+    status = append_snippet() ? IME_HID_OK : IME_HID_ERROR;
+    snip_stage_trigger = snip_stage_len = 0;
+    break;
+  case IME_HID_SNIP_ERASE:  // [cmd]
+    {
+      uint16_t magic = 0;
+      log_write(0, &magic, sizeof(magic));
+      build_snippet_index();
+    }
+    break;
+  case IME_HID_STATS:  // [cmd, reset]; reply [cmd, status, ime_stats_t]
+    memcpy(data + 2, &ime_stats, sizeof(ime_stats));
+    if (len) {
+      memset(&ime_stats, 0, sizeof(ime_stats));
+    }
+    break;
+#ifdef IME_HEATMAP_ENABLE
+  case IME_HID_HEAT_READ:  // [cmd, 0, layer, first]; reply [cmd, status, layer, first, counts...]
+    {
+      uint8_t layer = data[2], first = data[3];
+      uint8_t room  = (length - 4) / sizeof(uint16_t);
+      uint8_t count = MIN(room, HEAT_KEYS - first);
+      if (layer >= IME_LAYERS || first >= HEAT_KEYS) {
+        status = IME_HID_ERROR;
+        break;
+      }
+      memcpy(data + 4, &heat[layer][first], count * sizeof(uint16_t));
+    }
+    break;
+  case IME_HID_HEAT_RESET:  // [cmd]
+    memset(heat, 0, sizeof(heat));
+    mark_heatmap();
+    break;
+#endif
+#ifdef IME_HENKAN_ENABLE
+  case IME_HID_HENKAN_HELLO:  // [cmd]
+    henkan_host = true;
+    break;
+  case IME_HID_HENKAN_CANDS:  // [cmd, seq, chunk_len, candidates...], each NUL ended
+    if (data[2] > length - 3) {
+      status = IME_HID_ERROR;
+      break;
+    }
+    receive_henkan(data[1], data + 3, data[2]);
+    break;
+  case IME_HID_HENKAN_DONE:  // [cmd, seq]
+    finish_henkan(data[1]);
+    break;
+#endif
+  default:
+    status = IME_HID_UNKNOWN;
+  }
+
+  data[1] = status;
+  raw_hid_send(data, length);
+}
+
+// --- Composition timeout ---
+// The gap between keys of one romaji sequence is tracked as a moving
+// average and variance, each key weighing 1/4. A sequence is given up
+// TIMEOUT_SPREAD deviations past the average gap, so a fast typist's stray
+// consonant doesn't linger for seconds and a slow one isn't cut off.
+#define GAP_START (TIMEOUT_MS / (1 + TIMEOUT_SPREAD))
+
+static int32_t gap_avg = GAP_START << 4;        // ms, 4 fraction bits
+static int32_t gap_var = GAP_START * GAP_START;  // ms squared
+
+static uint16_t isqrt(uint32_t n) {
+  uint32_t root = 0, bit = 1UL << 30;
+  while (bit > n) { bit >>= 2; }
+  for (; bit; bit >>= 2) {
+    if (n >= root + bit) {
+      n -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+  }
+  return root;
+}
+
+static void learn_key_gap(uint16_t gap) {
+  int32_t diff = ((int32_t)MIN(gap, TIMEOUT_MAX_MS) << 4) - gap_avg;
+  gap_avg += diff / 4;
+  gap_var += ((diff >> 4) * (diff >> 4) - gap_var) / 4;
+
+  uint32_t t = (gap_avg >> 4) + TIMEOUT_SPREAD * isqrt(gap_var);
+  timeout    = MAX(TIMEOUT_MIN_MS, MIN(t, TIMEOUT_MAX_MS));
+}
+
+// Handles one event. Returns true if the key should be fed to the romaji matcher.
 static bool update_recent_keys(uint16_t keycode, keyrecord_t* record) {
   if (!record->event.pressed) { return false; }
- 
+
   if (((get_mods() | get_oneshot_mods()) & ~MOD_MASK_SHIFT) != 0) {
-    clear_recent_keys();  // Avoid interfering with hotkeys.
+    // Avoid interfering with hotkeys. A modifier's own key flushes below
+    // before it goes down; one already held would turn letters into hotkeys.
+    abandon_recent_keys();
+    clear_snippet_keys();
     return false;
   }
 
   switch (keycode) {
     case KC_A ... KC_SLASH:  // These keys type letters, digits, symbols.
       break;
-    case UC(0x3040) ... UC(0x30FF): // Hiragana + Katakana
-    case UC(0x4E00) ... UC(0x767E): // plus numerals
+    case QK_UNICODEMAP ... QK_UNICODEMAP + UNICODE_IME_KEYS - 1:  // kana, numerals
       break;
     case KC_LSFT:  // These keys don't type anything on their own.
     case KC_RSFT:
@@ -38,2445 +1628,242 @@ static bool update_recent_keys(uint16_t keycode, keyrecord_t* record) {
       return false;
 
     default:  // Avoid acting otherwise, particularly on navigation keys.
-      clear_recent_keys();
+      flush_recent_keys();  // typed before the key moves off them
+      clear_snippet_keys();
       return false;
   }
 
-  // Slide the buffer left by one element.
-  memmove(recent, recent + 1, (RECENT_SIZE - 1) * sizeof(*recent));
-
-  recent[RECENT_SIZE - 1] = keycode;
-  deadline = record->event.time + TIMEOUT_MS;
+  // a key that comes after a timeout still shows how slow the gap was
+  if (recent_len || timed_out) {
+    learn_key_gap(record->event.time - key_time);
+  }
+  timed_out = false;
+  key_time  = record->event.time;
+  deadline = key_time + timeout;
   return true;
 }
 
+// --- Shift ---
+// Shift is a plain modifier on the kana layers. A key pressed with it held
+// stands for its shifted form, read by index from unicode.def; the few
+// keys with none there take theirs from the SUPP layers in keymap.c. No
+// layer is pushed, so a shifted key costs what an unshifted one does.
+static uint16_t shifted_keycode(uint16_t keycode, keyrecord_t *record) {
+  if (!(get_mods() & MOD_MASK_SHIFT) || (get_mods() & ~MOD_MASK_SHIFT)) {
+    return 0;
+  }
+  uint8_t layer = layer_switch_get_layer(record->event.key);
+  if (layer != HIRAGANA && layer != KATAKANA) {
+    return 0;
+  }
+  if (keycode >= QK_UNICODEMAP && keycode < QK_UNICODEMAP + UNICODE_KEYS) {
+    uint16_t shifted = pgm_read_word(&unicode_shifted[QK_UNICODEMAP_GET_INDEX(keycode)]);
+    if (shifted) {
+      return shifted;
+    }
+  }
+  uint16_t shifted = keymap_key_to_keycode(layer == HIRAGANA ? HIRAGANA_SUPP : KATAKANA_SUPP, record->event.key);
+  return shifted == KC_TRNS ? 0 : shifted;
+}
+
+// Does what QMK would with a shifted keycode the IME let through; QMK
+// itself only ever sees the unshifted one.
+static void pass_shifted(uint16_t keycode, keyrecord_t *record) {
+  if (!record->event.pressed) {
+    return;
+  }
+  if (IS_QK_UNICODEMAP(keycode)) {
+    send_char(unicode_codepoint(keycode));
+  } else if (keycode == UC_NEXT) {
+    drain_emit_queue();  // text already queued goes out in the old mode
+    unicode_input_mode_step();
+  }
+}
+
+// --- Rollover ---
+// Keys down, with whether QMK got their press. At speed the next key goes
+// down before the last comes up, so a release can't be judged by the state
+// at release time: it goes to QMK exactly when its press did, and a press
+// the IME kept back is released quietly. A shifted press is released as
+// the keycode it stood for, whether Shift is still down or not.
+typedef struct {
+  keypos_t key;
+  bool     passed;   // ime_process_record returned true for the press
+  uint16_t shifted;  // what the press stood for with Shift, or 0
+} key_down_t;
+
+static key_down_t keys_down[ROLLOVER_MAX];
+static uint8_t    keys_down_len = 0;
+
+static void press_key(keypos_t key, bool passed, uint16_t shifted) {
+  if (keys_down_len < ROLLOVER_MAX) {
+    keys_down[keys_down_len++] = (key_down_t){key, passed, shifted};
+  }
+}
+
+// Takes `key` off the list. A key not seen counts as passed to QMK.
+static key_down_t release_key(keypos_t key) {
+  for (uint8_t i = 0; i < keys_down_len; i++) {
+    if (keys_down[i].key.row == key.row && keys_down[i].key.col == key.col) {
+      key_down_t down = keys_down[i];
+      memmove(&keys_down[i], &keys_down[i + 1], (--keys_down_len - i) * sizeof(key_down_t));
+      return down;
+    }
+  }
+  return (key_down_t){key, true, 0};
+}
+
+static bool process_event(uint16_t keycode, keyrecord_t *record);
+
+#ifdef IME_HOLD_ENABLE
+// --- Hold for small kana ---
+// A vowel or ん is typed when it comes up or when the next key goes down,
+// whichever is first, so a tap waits for no timer. Only a key still down
+// HOLD_TERM_MS after its press is typed, from the matrix scan, as its
+// small form: ぁ for あ, っ for ん.
+static uint16_t    held_keycode = 0;  // press not yet told tap from hold, 0 if none
+static keyrecord_t held_record;
+
+// The small kana a held key gives, or 0 if holding it does nothing.
+static uint16_t small_keycode(uint16_t keycode) {
+  char c = romaji_char(keycode);
+  if (keycode == UM(KANA_N)) {
+    return UM(KANA_TSU_SM);
+  } else if (IS_IME_UNICODE(keycode) && c && strchr("aeiou", c)) {
+    return pgm_read_word(&unicode_shifted[QK_UNICODEMAP_GET_INDEX(keycode)]);
+  }
+  return 0;
+}
+
+// Types the waiting press, as its small form if it was held.
+static void settle_held_key(bool held) {
+  uint16_t keycode = held ? small_keycode(held_keycode) : held_keycode;
+  held_keycode     = 0;
+  process_event(keycode, &held_record);
+}
+
+static void check_held_key(void) {
+  if (held_keycode && timer_elapsed(held_record.event.time) >= HOLD_TERM_MS) {
+    drain_emit_queue();
+    settle_held_key(true);
+  }
+}
+#endif
+
 bool ime_process_record(uint16_t keycode, keyrecord_t *record) {
+  drain_emit_queue();  // the mods read below are the user's again
+#ifdef IME_CAPTURE_ENABLE
+  capture_event(keycode, record);
+#endif
+  if (!record->event.pressed) {
+#ifdef IME_HOLD_ENABLE
+    if (held_keycode && held_record.event.key.row == record->event.key.row &&
+        held_record.event.key.col == record->event.key.col) {
+      settle_held_key((uint16_t)(record->event.time - held_record.event.time) >= HOLD_TERM_MS);
+    }
+#endif
+    key_down_t down = release_key(record->event.key);
+    if (down.shifted) {
+      if (process_event(down.shifted, record)) {
+        pass_shifted(down.shifted, record);
+      }
+      return false;
+    }
+    if (down.passed && process_event(keycode, record)) {
+      drain_emit_queue();
+      return true;
+    }
+    return false;
+  }
+
+  ime_stats.keys++;
+#ifdef IME_HEATMAP_ENABLE
+  count_press(record);
+#endif
+#ifdef IME_TRACE_ENABLE
+  trace_press(keycode, record);
+#endif
+#ifdef IME_HOLD_ENABLE
+  if (held_keycode) {
+    settle_held_key(false);  // the next key went down first: a tap
+  }
+  // a vowel that would finish a syllable is typed right away
+  if (!get_mods() && recent_len == recent_shown && small_keycode(keycode)) {
+    held_keycode = keycode;
+    held_record  = *record;
+    press_key(record->event.key, false, 0);
+    return false;
+  }
+#endif
+  uint16_t shifted = shifted_keycode(keycode, record);
+  bool     passed  = false;
+  if (!shifted) {
+    passed = process_event(keycode, record);
+  } else if (process_event(shifted, record)) {
+    pass_shifted(shifted, record);
+  }
+  if (passed) {
+    drain_emit_queue();  // QMK's own report goes out after the IME's text
+    if (!(keycode >= KC_LCTL && keycode <= KC_RGUI)) {
+      last_kana = 0;  // QMK types something after it, or moves off it
+    }
+  }
+  press_key(record->event.key, passed, shifted);
+  return passed;
+}
+
+static bool process_event(uint16_t keycode, keyrecord_t *record) {
   // Pass Ctrl+everything through before any layer or IME logic
   if (record->event.pressed && (get_mods() & MOD_MASK_CTRL)) {
     return true;  // Let QMK handle it normally
   }
 
-  if (update_recent_keys(keycode, record)) {
-    if (record->event.pressed) {
-      if (IS_LAYER_ON(HIRAGANA) ) {
-
-        // K - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_K) {
-          if (recent[RECENT_SIZE - 2] == KC_K) {
-            // MATCH KK_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っか");
-              break;
-            case UC(HRGN_E):
-              send_unicode_string("っけ");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("っき");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っこ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っく");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH KY_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("きゃ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("きょ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("きゅ");
-              break;
-            }
-          }
-          // any unmatched k** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_K) {
-          // if K isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("か");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_E):
-            send_unicode_string("け");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            send_unicode_string("き");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("こ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("く");
-            clear_recent_keys();
-            break;
-          case KC_K:
-          case KC_Y:
-            // K,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched k* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // G - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_G) {
-          if (recent[RECENT_SIZE - 2] == KC_G) {
-            // MATCH GG_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っぎ");
-              break;
-            case UC(HRGN_E):
-              send_unicode_string("っげ");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("っぎ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っご");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っぐ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH GY_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("ぎゃ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("ぎょ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("ぎゅ");
-              break;
-            }
-          }
-          // any unmatched g** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_G) {
-          // if G isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("が");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_E):
-            send_unicode_string("げ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            send_unicode_string("ぎ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("ご");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("ぐ");
-            clear_recent_keys();
-            break;
-          case KC_G:
-          case KC_Y:
-            // G,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched g* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // T - SERIES
-        // Position T-Series before S-Series to ensure TSU can be captured.
-        if (recent[RECENT_SIZE - 3] == KC_T) {
-          if (recent[RECENT_SIZE - 2] == KC_T) {
-            // MATCH TT_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("った");
-              break;
-            case UC(HRGN_E):
-              send_unicode_string("って");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("っち");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っと");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っつ");
-              break;
-            case KC_S:
-              send_unicode_string("っつ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_S) {
-            // MATCH TS_
-            switch (keycode) {
-            case UC(HRGN_U):
-              send_unicode_string("つ");
-              break;
-            case UC(HRGN_U_SM):
-              send_unicode_string("っ");
-              break;
-            default:
-              send_unicode_string("っ");
-              break;
-            }
-          }
-          // any unmatched t** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_T) {
-          // if T isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("た");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_E):
-            send_unicode_string("て");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            send_unicode_string("ち");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("と");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("つ");
-            clear_recent_keys();
-            break;
-          case KC_T:
-          case KC_S:
-            // T,S exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched t* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // S - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_S) {
-          if (recent[RECENT_SIZE - 2] == KC_S) {
-            // MATCH SS_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っさ");
-              break;
-            case UC(HRGN_E):
-              send_unicode_string("っせ");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("っし");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っそ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っす");
-              break;
-            case KC_H:
-              send_unicode_string("っし");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_H) {
-            // MATCH SH_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("しゃ");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("し");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("しょ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("しゅ");
-              break;
-            }
-          }
-          // any unmatched s** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_S) {
-          // if S isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("さ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_E):
-            send_unicode_string("せ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            send_unicode_string("し");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("そ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("す");
-            clear_recent_keys();
-            break;
-          case KC_S:
-          case KC_H:
-            // S,H exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched s* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // Z - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_Z) {
-          if (recent[RECENT_SIZE - 2] == KC_Z) {
-            // MATCH ZZ_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っざ");
-              break;
-            case UC(HRGN_E):
-              send_unicode_string("っぜ");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("っじ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っぞ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っず");
-              break;
-            }
-          }
-          // any unmatched z** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_Z) {
-          // if Z isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("ざ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_E):
-            send_unicode_string("ぜ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            send_unicode_string("じ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("ぞ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("ず");
-            clear_recent_keys();
-            break;
-          case KC_Z:
-            // Z exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched z* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // J - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_J) {
-          if (recent[RECENT_SIZE - 2] == KC_J) {
-            // MATCH JJ_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っじゃ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っじょ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っじゅ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH JY_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("じゃ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("じょ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("じゅ");
-              break;
-            }
-          }
-          // any unmatched j** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_J) {
-          // if J isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("じゃ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            send_unicode_string("じ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("じょ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("じゅ");
-            clear_recent_keys();
-            break;
-          case KC_J:
-          case KC_Y:
-            // J,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched j* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // C - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_C) {
-          if (recent[RECENT_SIZE - 2] == KC_H) {
-            // MATCH CH_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("ちゃ");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("ち");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("ちょ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("ちゅ");
-              break;
-            }
-          }
-          // any unmatched c** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        }
-
-        // D - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_D) {
-          if (recent[RECENT_SIZE - 2] == KC_D) {
-            // MATCH DD_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っだ");
-              break;
-            case UC(HRGN_E):
-              send_unicode_string("っで");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("っぢ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っど");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っづ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Z) {
-            // MATCH DZ_
-            switch (keycode) {
-            case UC(HRGN_U):
-              send_unicode_string("っづ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_J) {
-            // MATCH DJ_
-            switch (keycode) {
-            case UC(HRGN_I):
-              send_unicode_string("ぢ");
-              break;
-            }
-          }
-          // any unmatched d** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_D) {
-          // if D isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("だ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_E):
-            send_unicode_string("で");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            send_unicode_string("ぢ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("ど");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("づ");
-            clear_recent_keys();
-            break;
-          case KC_D:
-          case KC_Z:
-          case KC_J:
-            // D,Z,J exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched d* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // N - SERIES
-        if (recent[RECENT_SIZE - 3] == UC(HRGN_N)) {
-          if (recent[RECENT_SIZE - 2] == UC(HRGN_N)) {
-            // MATCH NN_
-            switch (keycode) {
-            case UC(HRGN_A):
-              tap_code(KC_BSPC);
-              send_unicode_string("っな");
-              break;
-            case UC(HRGN_E):
-              tap_code(KC_BSPC);
-              send_unicode_string("っね");
-              break;
-            case UC(HRGN_I):
-              tap_code(KC_BSPC);
-              send_unicode_string("っに");
-              break;
-            case UC(HRGN_O):
-              tap_code(KC_BSPC);
-              send_unicode_string("っの");
-              break;
-            case UC(HRGN_U):
-              tap_code(KC_BSPC);
-              send_unicode_string("っぬ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH NY_
-            switch (keycode) {
-            case UC(HRGN_A):
-              tap_code(KC_BSPC);
-              send_unicode_string("にゃ");
-              break;
-            case UC(HRGN_O):
-              tap_code(KC_BSPC);
-              send_unicode_string("にょ");
-              break;
-            case UC(HRGN_U):
-              tap_code(KC_BSPC);
-              send_unicode_string("にゅ");
-              break;
-            }
-          }
-          // any unmatched n** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == UC(HRGN_N)) {
-          // if N isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            tap_code(KC_BSPC);
-            send_unicode_string("な");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_E):
-            tap_code(KC_BSPC);
-            send_unicode_string("ね");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            tap_code(KC_BSPC);
-            send_unicode_string("に");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            tap_code(KC_BSPC);
-            send_unicode_string("の");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            tap_code(KC_BSPC);
-            send_unicode_string("ぬ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_N):
-          case KC_Y:
-            // UC(HRGN_N),Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched n* 2char clears
-            clear_recent_keys();
-            update_recent_keys(keycode, record);
-          }
-          return false;
-        }
-
-        // H - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_H) {
-          if (recent[RECENT_SIZE - 2] == KC_H) {
-            // MATCH HH_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っは");
-              break;
-            case UC(HRGN_E):
-              send_unicode_string("っへ");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("っひ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っほ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っふ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH HY_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("ひゃ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("ひょ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("ひゅ");
-              break;
-            }
-          }
-          // any unmatched h** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_H) {
-          // if H isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("は");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_E):
-            send_unicode_string("へ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            send_unicode_string("ひ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("ほ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("ふ");
-            clear_recent_keys();
-            break;
-          case KC_H:
-          case KC_Y:
-            // H,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched h* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // F - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_F) {
-          if (recent[RECENT_SIZE - 2] == KC_F) {
-            // MATCH FF_
-            switch (keycode) {
-            case UC(HRGN_U):
-              send_unicode_string("っふ");
-              break;
-            }
-          }
-          // any unmatched f** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_F) {
-          // if F isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_U):
-            send_unicode_string("ふ");
-            clear_recent_keys();
-            break;
-          case KC_F:
-            // F exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched f* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // B - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_B) {
-          if (recent[RECENT_SIZE - 2] == KC_B) {
-            // MATCH BB_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っば");
-              break;
-            case UC(HRGN_E):
-              send_unicode_string("っべ");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("っび");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っぼ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っぶ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH BY_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("びゃ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("びょ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("びゅ");
-              break;
-            }
-          }
-          // any unmatched b** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_B) {
-          // if B isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("ば");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_E):
-            send_unicode_string("べ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            send_unicode_string("び");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("ぼ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("ぶ");
-            clear_recent_keys();
-            break;
-          case KC_B:
-          case KC_Y:
-            // B,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched b* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // P - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_P) {
-          if (recent[RECENT_SIZE - 2] == KC_P) {
-            // MATCH PP_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っぱ");
-              break;
-            case UC(HRGN_E):
-              send_unicode_string("っぺ");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("っぴ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っぽ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っぷ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH PY_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("ぴゃ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("ぴょ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("ぴゅ");
-              break;
-            }
-          }
-          // any unmatched p** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_P) {
-          // if P isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("ぱ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_E):
-            send_unicode_string("ぺ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            send_unicode_string("ぴ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("ぽ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("ぷ");
-            clear_recent_keys();
-            break;
-          case KC_P:
-          case KC_Y:
-            // P,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched p* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // M - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_M) {
-          if (recent[RECENT_SIZE - 2] == KC_M) {
-            // MATCH MM_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っま");
-              break;
-            case UC(HRGN_E):
-              send_unicode_string("っめ");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("っみ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っも");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っむ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH MY_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("みゃ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("みょ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("みゅ");
-              break;
-            }
-          }
-          // any unmatched m** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_M) {
-          // if M isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("ま");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_E):
-            send_unicode_string("め");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            send_unicode_string("み");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("も");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("む");
-            clear_recent_keys();
-            break;
-          case KC_M:
-          case KC_Y:
-            // M,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched m* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // R - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_R) {
-          if (recent[RECENT_SIZE - 2] == KC_R) {
-            // MATCH RR_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っら");
-              break;
-            case UC(HRGN_E):
-              send_unicode_string("っれ");
-              break;
-            case UC(HRGN_I):
-              send_unicode_string("っり");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っろ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っる");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH RY_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("りゃ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("りょ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("りゅ");
-              break;
-            }
-          }
-          // any unmatched r** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_R) {
-          // if R isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("ら");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_E):
-            send_unicode_string("れ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_I):
-            send_unicode_string("り");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("ろ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("る");
-            clear_recent_keys();
-            break;
-          case KC_R:
-          case KC_Y:
-            // R,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched r* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // W - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_W) {
-          if (recent[RECENT_SIZE - 2] == KC_W) {
-            // MATCH WW_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っわ");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っを");
-              break;
-            }
-          }
-          // any unmatched w** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_W) {
-          // if W isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("わ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("を");
-            clear_recent_keys();
-            break;
-          case KC_W:
-            // W exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched w* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // Y - SERIES
-        /* Needs to come after all other letters that might use Y
-        // Such as Ryo, Mya... to ensure proper execution that this
-        // does not clear recent keys on 2nd key Y */
-        if (recent[RECENT_SIZE - 3] == KC_Y) {
-          if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH YY_
-            switch (keycode) {
-            case UC(HRGN_A):
-              send_unicode_string("っや");
-              break;
-            case UC(HRGN_O):
-              send_unicode_string("っよ");
-              break;
-            case UC(HRGN_U):
-              send_unicode_string("っゆ");
-              break;
-            }
-          }
-          // any unmatched f** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-          // if Y isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(HRGN_A):
-            send_unicode_string("や");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O):
-            send_unicode_string("よ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U):
-            send_unicode_string("ゆ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_A_SM):
-            send_unicode_string("ゃ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_O_SM):
-            send_unicode_string("ょ");
-            clear_recent_keys();
-            break;
-          case UC(HRGN_U_SM):
-            send_unicode_string("ゅ");
-            clear_recent_keys();
-            break;
-          case KC_Y:
-            // Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched y* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // NUM - SERIES
-        if (recent[RECENT_SIZE - 3] == UC(JP_NUM_1)) {
-          if (recent[RECENT_SIZE - 2] == UC(HRGN_E)) {
-            // MATCH 1E_
-            tap_code(KC_BSPC);
-            tap_code(KC_BSPC);
-            // right or wrong, backspace. 1,E have already been
-            // pressed, entered, so they should always get removed
-            switch (keycode) {
-            case UC(JP_NUM_10):
-              send_unicode_string("〇"); // maru/zero for 1e0 despite the math
-              break;
-            case UC(JP_NUM_1):
-              send_unicode_string("十");
-              break;
-            case UC(JP_NUM_2):
-              send_unicode_string("百");
-              break;
-            case UC(JP_NUM_3):
-              send_unicode_string("千");
-              break;
-            case UC(JP_NUM_4):
-              send_unicode_string("万");
-              break;
-            case UC(JP_NUM_8):
-              send_unicode_string("億");
-              break;
-            case KC_W:
-              send_unicode_string("兆");
-              break;
-            }
-            unregister_code(keycode);
-            clear_recent_keys();
-            return false;
-          } // end e-press
-
-        }
-        // END HIRAGANA
-      } else if (IS_LAYER_ON(KATAKANA) ) {
-        /* START KATAKANA HERE
-        ****************************************
-        ****************************************
-        ****************************************
-        ****************************************
-        ****************************************
-        ****************************************
-        ************************************* */
-        // K - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_K) {
-          if (recent[RECENT_SIZE - 2] == KC_K) {
-            // MATCH KK_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッカ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("ッケ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("ッキ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッコ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ック");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH KY_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("キャ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("キョ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("キュ");
-              break;
-            }
-          }
-          // any unmatched k** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_K) {
-          // if K isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("カ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("ケ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("キ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("コ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("ク");
-            clear_recent_keys();
-            break;
-          case KC_K:
-          case KC_Y:
-            // K,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched k* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // G - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_G) {
-          if (recent[RECENT_SIZE - 2] == KC_G) {
-            // MATCH GG_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッギ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("ッゲ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("ッギ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッゴ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ッグ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH GY_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ギャ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ギョ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ギュ");
-              break;
-            }
-          }
-          // any unmatched g** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_G) {
-          // if G isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("が");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("ゲ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("ギ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ゴ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("グ");
-            clear_recent_keys();
-            break;
-          case KC_G:
-          case KC_Y:
-            // G,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched g* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // T - SERIES
-        // Position T-Series before S-Series to ensure TSU can be captured.
-        if (recent[RECENT_SIZE - 3] == KC_T) {
-          if (recent[RECENT_SIZE - 2] == KC_T) {
-            // MATCH TT_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッタ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("ッテ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("ッチ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ット");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ッツ");
-              break;
-            case KC_S:
-              send_unicode_string("ッツ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_S) {
-            // MATCH TS_
-            switch (keycode) {
-            case UC(KTKN_U):
-              send_unicode_string("ツ");
-              break;
-            case UC(KTKN_U_SM):
-              send_unicode_string("ッ");
-              break;
-            default:
-              send_unicode_string("ッ");
-              break;
-            }
-          }
-          // any unmatched t** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_T) {
-          // if T isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("タ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("テ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("ティ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ト");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("トゥ");
-            clear_recent_keys();
-            break;
-          case KC_Y:
-            send_unicode_string("テュ");
-            clear_recent_keys();
-            break;
-          case KC_T:
-          case KC_S:
-            // T,S exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched t* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // S - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_S) {
-          if (recent[RECENT_SIZE - 2] == KC_S) {
-            // MATCH SS_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッサ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("ッセ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("ッシ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッソ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ッス");
-              break;
-            case KC_H:
-              send_unicode_string("ッシ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_H) {
-            // MATCH SH_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("シャ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("シェ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("シ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ショ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("シュ");
-              break;
-            }
-          }
-          // any unmatched s** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_S) {
-          // if S isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("サ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("セ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("シ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ソ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("ス");
-            clear_recent_keys();
-            break;
-          case KC_S:
-          case KC_H:
-            // S,H exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched s* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // Z - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_Z) {
-          if (recent[RECENT_SIZE - 2] == KC_Z) {
-            // MATCH ZZ_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッザ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("ッゼ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("ッジ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッゾ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ッズ");
-              break;
-            }
-          }
-          // any unmatched z** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_Z) {
-          // if Z isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("ザ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("ゼ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("ジ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ゾ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("ズ");
-            clear_recent_keys();
-            break;
-          case KC_Z:
-            // Z exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched z* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // J - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_J) {
-          if (recent[RECENT_SIZE - 2] == KC_J) {
-            // MATCH JJ_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッジャ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッジョ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ッジュ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH JY_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ジャ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ジョ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ジュ");
-              break;
-            }
-          }
-          // any unmatched j** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_J) {
-          // if J isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("ジャ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("ジェ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("ジ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ジョ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("ジュ");
-            clear_recent_keys();
-            break;
-          case KC_J:
-          case KC_Y:
-            // J,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched j* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // C - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_C) {
-          if (recent[RECENT_SIZE - 2] == KC_H) {
-            // MATCH CH_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("チャ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("チェ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("チ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("チョ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("チュ");
-              break;
-            }
-          }
-          // any unmatched c** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        }
-
-        // D - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_D) {
-          if (recent[RECENT_SIZE - 2] == KC_D) {
-            // MATCH DD_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッダ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("ッデ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("ッヂ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッド");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ッヅ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Z) {
-            // MATCH DZ_
-            switch (keycode) {
-            case UC(KTKN_U):
-              send_unicode_string("ッヅ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_J) {
-            // MATCH DJ_
-            switch (keycode) {
-            case UC(KTKN_I):
-              send_unicode_string("ヂ");
-              break;
-            }
-          }
-          // any unmatched d** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_D) {
-          // if D isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("ダ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("デ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("ディ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ド");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("ドゥ");
-            clear_recent_keys();
-            break;
-          case KC_Y:
-            send_unicode_string("ドュ");
-            clear_recent_keys();
-            break;
-          case KC_D:
-          case KC_Z:
-          case KC_J:
-            // D,Z,J exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched d* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // N - SERIES
-        if (recent[RECENT_SIZE - 3] == UC(KTKN_N)) {
-          if (recent[RECENT_SIZE - 2] == UC(KTKN_N)) {
-            // MATCH NN_
-            switch (keycode) {
-            case UC(KTKN_A):
-              tap_code(KC_BSPC);
-              send_unicode_string("ッナ");
-              break;
-            case UC(KTKN_E):
-              tap_code(KC_BSPC);
-              send_unicode_string("ッネ");
-              break;
-            case UC(KTKN_I):
-              tap_code(KC_BSPC);
-              send_unicode_string("ッニ");
-              break;
-            case UC(KTKN_O):
-              tap_code(KC_BSPC);
-              send_unicode_string("ッノ");
-              break;
-            case UC(KTKN_U):
-              tap_code(KC_BSPC);
-              send_unicode_string("ッヌ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH NY_
-            switch (keycode) {
-            case UC(KTKN_A):
-              tap_code(KC_BSPC);
-              send_unicode_string("ニャ");
-              break;
-            case UC(KTKN_O):
-              tap_code(KC_BSPC);
-              send_unicode_string("ニョ");
-              break;
-            case UC(KTKN_U):
-              tap_code(KC_BSPC);
-              send_unicode_string("ニュ");
-              break;
-            }
-          }
-          // any unmatched n** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == UC(KTKN_N)) {
-          // if N isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            tap_code(KC_BSPC);
-            send_unicode_string("ナ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            tap_code(KC_BSPC);
-            send_unicode_string("ネ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            tap_code(KC_BSPC);
-            send_unicode_string("ニ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            tap_code(KC_BSPC);
-            send_unicode_string("ノ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            tap_code(KC_BSPC);
-            send_unicode_string("ヌ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_N):
-          case KC_Y:
-            // UC(KTKN_N),Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched n* 2char clears
-            clear_recent_keys();
-            update_recent_keys(keycode, record);
-          }
-          return false;
-        }
-
-        // H - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_H) {
-          if (recent[RECENT_SIZE - 2] == KC_H) {
-            // MATCH HH_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッハ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("ッヘ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("ッヒ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッホ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ッフ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH HY_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ヒャ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ヒョ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ヒュ");
-              break;
-            }
-          }
-          // any unmatched h** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_H) {
-          // if H isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("ハ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("ヘ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("ヒ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ホ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("フ");
-            clear_recent_keys();
-            break;
-          case KC_H:
-          case KC_Y:
-            // H,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched h* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // F - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_F) {
-          if (recent[RECENT_SIZE - 2] == KC_F) {
-            // MATCH FF_
-            switch (keycode) {
-            case UC(KTKN_U):
-              send_unicode_string("ッフ");
-              break;
-            }
-          } 
-          // any unmatched f** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_F) {
-          // if F isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("ファ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("フェ");
-            clear_recent_keys(); 
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("フィ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("フォ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("フ");
-            clear_recent_keys();
-            break;
-          case KC_F:
-            // F exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched f* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // B - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_B) {
-          if (recent[RECENT_SIZE - 2] == KC_B) {
-            // MATCH BB_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッバ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("ッベ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("ッビ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッボ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ッブ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH BY_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ビャ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ビョ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ビュ");
-              break;
-            }
-          }
-          // any unmatched b** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_B) {
-          // if B isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("バ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("ベ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("ビ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ボ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("ブ");
-            clear_recent_keys();
-            break;
-          case KC_B:
-          case KC_Y:
-            // B,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched b* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // P - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_P) {
-          if (recent[RECENT_SIZE - 2] == KC_P) {
-            // MATCH PP_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッパ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("ッペ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("ッピ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッポ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ップ");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH PY_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ピャ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ピョ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ピュ");
-              break;
-            }
-          }
-          // any unmatched p** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_P) {
-          // if P isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("パ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("ペ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("ピ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ポ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("プ");
-            clear_recent_keys();
-            break;
-          case KC_P:
-          case KC_Y:
-            // P,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched p* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // M - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_M) {
-          if (recent[RECENT_SIZE - 2] == KC_M) {
-            // MATCH MM_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッマ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("ッメ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("ッミ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッモ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ッム");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH MY_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ミャ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ミョ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ミュ");
-              break;
-            }
-          }
-          // any unmatched m** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_M) {
-          // if M isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("マ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("メ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("ミ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("モ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("ム");
-            clear_recent_keys();
-            break;
-          case KC_M:
-          case KC_Y:
-            // M,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched m* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // R - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_R) {
-          if (recent[RECENT_SIZE - 2] == KC_R) {
-            // MATCH RR_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッラ");
-              break;
-            case UC(KTKN_E):
-              send_unicode_string("ッレ");
-              break;
-            case UC(KTKN_I):
-              send_unicode_string("ッリ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッロ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ッル");
-              break;
-            }
-          } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH RY_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("リャ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("リョ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("リュ");
-              break;
-            }
-          }
-          // any unmatched r** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_R) {
-          // if R isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("ラ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("レ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("リ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ロ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("ル");
-            clear_recent_keys();
-            break;
-          case KC_R:
-          case KC_Y:
-            // R,Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched r* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // V - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_V) {
-          if (recent[RECENT_SIZE - 2] == KC_V) {
-            // MATCH VV_
-            switch (keycode) {
-            case UC(KTKN_U):
-              send_unicode_string("ッヴ");
-              break;
-            }
-          }
-          // any unmatched v** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_V) {
-          // if V isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("ヴァ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("ヴェ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("ヴィ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ヴォ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("ヴ");
-            clear_recent_keys();
-            break;
-          case KC_V:
-            // V exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched v* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // W - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_W) {
-          if (recent[RECENT_SIZE - 2] == KC_W) {
-            // MATCH WW_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッわ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッを");
-              break;
-            }
-          }
-          // any unmatched w** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_W) {
-          // if W isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("ワ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_E):
-            send_unicode_string("ウェ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_I):
-            send_unicode_string("ウィ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ウォ");
-            clear_recent_keys();
-            break;
-          case KC_W:
-            // W exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched w* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // Y - SERIES
-        if (recent[RECENT_SIZE - 3] == KC_Y) {
-          if (recent[RECENT_SIZE - 2] == KC_Y) {
-            // MATCH YY_
-            switch (keycode) {
-            case UC(KTKN_A):
-              send_unicode_string("ッヤ");
-              break;
-            case UC(KTKN_O):
-              send_unicode_string("ッヨ");
-              break;
-            case UC(KTKN_U):
-              send_unicode_string("ッユ");
-              break;
-            }
-          }
-          // any unmatched f** 3char clears
-          unregister_code(keycode);
-          clear_recent_keys();
-          return false;
-        } else if (recent[RECENT_SIZE - 2] == KC_Y) {
-          // if Y isn't 3rd most recent, is it still 2nd most recent?
-          unregister_code(keycode);
-          switch (keycode) {
-          case UC(KTKN_A):
-            send_unicode_string("ヤ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O):
-            send_unicode_string("ヨ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U):
-            send_unicode_string("ユ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_A_SM):
-            send_unicode_string("ャ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_O_SM):
-            send_unicode_string("ョ");
-            clear_recent_keys();
-            break;
-          case UC(KTKN_U_SM):
-            send_unicode_string("ュ");
-            clear_recent_keys();
-            break;
-          case KC_Y:
-            // Y exit immediately *without* clear to permit access to above 3 char stanza
-            return false;
-          default:
-            // any unmatched y* 2char clears
-            clear_recent_keys();
-          }
-          return false;
-        }
-
-        // NUM - SERIES
-        if (recent[RECENT_SIZE - 3] == UC(JP_NUM_1)) {
-          if (recent[RECENT_SIZE - 2] == UC(KTKN_E)) {
-            // MATCH 1E_
-            tap_code(KC_BSPC);
-            tap_code(KC_BSPC);
-            // right or wrong, backspace. 1,E have already been
-            // pressed, entered, so they should always get removed
-            switch (keycode) {
-            case UC(JP_NUM_10):
-              send_unicode_string("〇"); // maru/zero for 1e0 despite the math
-              break;
-            case UC(JP_NUM_1):
-              send_unicode_string("十");
-              break;
-            case UC(JP_NUM_2):
-              send_unicode_string("百");
-              break;
-            case UC(JP_NUM_3):
-              send_unicode_string("千");
-              break;
-            case UC(JP_NUM_4):
-              send_unicode_string("万");
-              break;
-            case UC(JP_NUM_8):
-              send_unicode_string("億");
-              break;
-            case KC_W:
-              send_unicode_string("兆");
-              break;
-            }
-            unregister_code(keycode);
-            clear_recent_keys();
-            return false;
-          } // end e-press
-
-        }
-
-      } // end katakana layer check
-    } // end record.pressed
-  } // end update_recent_keys
+  if ((IS_LAYER_ON(HIRAGANA) || IS_LAYER_ON(KATAKANA)) && update_recent_keys(keycode, record)) {
+    char c = romaji_char(keycode);
+    if (c && ime_config.output == OUT_FULLWIDTH) {  // the letter itself, widened
+      send_char(c >= 'a' && c <= 'z' && (get_mods() & MOD_MASK_SHIFT) ? c - 'a' + 'A' : c);
+      clear_snippet_keys();
+      return false;
+    }
+    // snippets go first: Space after a trigger expands it
+    if (keycode == KC_SPC && send_snippet()) {
+      return false;
+    }
+#ifdef IME_HENKAN_ENABLE
+    if (!process_henkan(keycode)) {
+      return false;
+    }
+#endif
+    // a voiced mark folded into the last kana stays in the word, though no
+    // trigger spells it
+    if (recent_len == recent_shown && fold_voiced_mark(keycode)) {
+      clear_recent_keys();
+      snip_len = SNIP_OFF;
+      return false;
+    }
+    update_snippet_keys(c);
+
+    if (c) {
+      if (!compose_recent_keys(c, keycode)) {
+        return false;
+      }
+      if (IS_IME_UNICODE(keycode)) {
+        send_kana(unicode_codepoint(keycode));  // ん, 一 and the like, shown right away
+        return false;
+      }
+      word_len = 0;  // a letter no romaji starts with
+    } else if (recent_len > recent_shown && (keycode == KC_BSPC || keycode == KC_ESC)) {
+      // Backspace and Escape take back the consonants held so far
+      abandon_recent_keys();
+      return false;
+    } else {
+      flush_recent_keys();  // then the key goes out as usual
+      if (IS_IME_UNICODE(keycode)) {
+        send_kana(unicode_codepoint(keycode));  // っ, ゛, ー in the active script
+        return false;
+      }
+    }
+  }
 
   switch (keycode) {
   case HRGA_GO:
@@ -2501,33 +1888,40 @@ bool ime_process_record(uint16_t keycode, keyrecord_t *record) {
       return false;
     }
     break;
-  case KC_K:
-  case KC_G:
-  case KC_S:
-  case KC_Z:
-  case KC_T:
-  case KC_D:
-  case KC_N:
-  case KC_H:
-  case KC_B:
-  case KC_P:
-  case KC_M:
-  case KC_Y:
-  case KC_R:
-  case KC_W:
-  case KC_V:
-  case KC_C:
-  case KC_F:
-  case KC_J:
-    if (IS_LAYER_ON(HIRAGANA) ) {
-      // unregister because it is already saved in recent buffer
-      unregister_code(keycode);
-      return false;
-    } else if (IS_LAYER_ON(KATAKANA) ) {
-      unregister_code(keycode);
+  case ROMA_NEXT:
+    if (record->event.pressed) {
+      ime_config.romaji = (ime_config.romaji + 1) % ROMA_PROFILES;
+      eeconfig_update_user(ime_config.raw);
+      abandon_recent_keys();
+    }
+    return false;
+  case OUT_NEXT:
+    if (record->event.pressed) {
+      ime_config.output = (ime_config.output + 1) % OUT_SCRIPTS;
+      eeconfig_update_user(ime_config.raw);
+      abandon_recent_keys();
+    }
+    return false;
+  case QK_UNICODEMAP ... QK_UNICODEMAP_MAX:  // the marks; kana keys were typed above
+    if (record->event.pressed && ime_config.output != OUT_KANA) {
+      send_char(unicode_codepoint(keycode));
       return false;
     }
     break;
+  case IME_TRACE:
+#ifdef IME_TRACE_ENABLE
+    if (record->event.pressed) {
+      dump_trace();
+    }
+#endif
+    return false;
+  case IME_CAPTURE:
+#ifdef IME_CAPTURE_ENABLE
+    if (record->event.pressed) {
+      dump_capture();
+    }
+#endif
+    return false;
   }
 
   return true;
@@ -8,19 +8,133 @@
 #define GUIS 6
 #define HIRAGANA_SUPP 7
 #define KATAKANA_SUPP 8
+#define IME_LAYERS 9  // layer indices used in keymap.c
 
-#define TIMEOUT_MS 3000  // Timeout in milliseconds.
-#define RECENT_SIZE 3    // Number of keys in `recent` buffer.
+#define TIMEOUT_MS 3000  // Composition timeout until the typing pace is learned.
+#define TIMEOUT_MIN_MS 400   // The learned timeout stays within these bounds.
+#define TIMEOUT_MAX_MS 5000
+#define TIMEOUT_SPREAD 4  // Standard deviations of the key gap allowed past its average.
+#define RECENT_SIZE 5    // Number of keys in `recent` buffer.
+#define ROLLOVER_MAX 10  // Keys tracked down at once.
+#define HOLD_TERM_MS 200  // Hold a vowel this long for its small kana (IME_HOLD_ENABLE).
+#define SNIP_MAX 6       // Longest snippet trigger, in keys.
+#define SNIP_SLOTS 64    // Snippet hash index size, a power of two.
+#define SNIP_PHRASE_MAX 96  // Longest user snippet phrase, in UTF-8 bytes.
+#define HENKAN_MAX 8     // Longest reading henkan converts, in kana.
+#define HENKAN_REMOTE_SIZE 128  // Candidates from the host helper, in UTF-8 bytes.
+#define HENKAN_HOST_TIMEOUT_MS 300  // Give up on the host helper after this long.
+#define HENKAN_LEARN_SLOTS 16  // Readings whose chosen candidate is remembered.
+#define HENKAN_LEARN_FLUSH_MS 30000  // Batch learned choices this long before writing EEPROM.
+#define HEAT_SNAPSHOT_MS 600000  // Save the heatmap this often while it changes.
+#define TRACE_SIZE 256  // Presses kept in the latency trace.
+#define CAPTURE_SIZE 512  // Presses and releases kept for replay.
+
+// Layout of the user EEPROM datablock (EECONFIG_USER_DATA_SIZE in config.h)
+#define SNIP_LOG_OFFSET 0
+#define SNIP_LOG_SIZE 512
+#define HENKAN_LEARN_OFFSET 512
+#define HENKAN_LEARN_SIZE 128
+#define HEAT_OFFSET 640
+#define HEAT_SIZE 1088
 
 enum {
   HRGA_GO = SAFE_RANGE,
   KTKN_GO,
-  ENG_GO
+  ENG_GO,
+  ROMA_NEXT,
+  OUT_NEXT,
+  IME_TRACE,   // print the latency trace to the console
+  IME_CAPTURE  // print the captured events to the console
+};
+
+// UNICODEMAP indices, UM(KANA_A) in keymap.c: the keys jp_ime.c types
+// first, then the marks QMK types
+enum {
+#define UKEY(name, codepoint, romaji, shifted) name,
+#define UMARK(name, codepoint, shifted)
+#include "unicode.def"
+  UNICODE_IME_KEYS,
+  UNICODE_MARK_BASE = UNICODE_IME_KEYS - 1,  // the first mark takes UNICODE_IME_KEYS
+#undef UKEY
+#undef UMARK
+#define UKEY(name, codepoint, romaji, shifted)
+#define UMARK(name, codepoint, shifted) name,
+#include "unicode.def"
+#undef UKEY
+#undef UMARK
+  UNICODE_KEYS
+};
+#define IS_IME_UNICODE(kc) ((kc) >= QK_UNICODEMAP && (kc) < QK_UNICODEMAP + UNICODE_IME_KEYS)
+
+#define IME_HID_REPORT_SIZE 32  // RAW_EPSIZE
+
+// Raw HID commands, in the first byte of each report. Replies echo the
+// report with the status in the second byte.
+enum {
+  IME_HID_SNIP_BEGIN = 0x40,  // start a user snippet: trigger
+  IME_HID_SNIP_DATA,          // append phrase bytes
+  IME_HID_SNIP_COMMIT,        // store it; an empty phrase deletes the trigger
+  IME_HID_SNIP_ERASE,         // drop every user snippet
+
+  IME_HID_HENKAN_HELLO = 0x50,  // a henkan helper is listening
+  IME_HID_HENKAN_QUERY,         // sent by the keyboard: seq, reading
+  IME_HID_HENKAN_CANDS,         // candidates for a query, in chunks
+  IME_HID_HENKAN_DONE,          // the last chunk has been sent
+
+  IME_HID_STATS = 0x60,         // read ime_stats_t, then zero it if asked
+  IME_HID_HEAT_READ,            // read heatmap counts for one layer
+  IME_HID_HEAT_RESET,           // zero the heatmap
 };
 
+enum {
+  IME_HID_OK,
+  IME_HID_ERROR,
+  IME_HID_UNKNOWN
+};
+
+// Romanization profiles, cycled with ROMA_NEXT
+enum {
+  ROMA_PERMISSIVE,  // every spelling in romaji.def
+  ROMA_HEPBURN,     // shi, chi, tsu, fu, ji, sha
+  ROMA_KUNREI,      // si, ti, tu, hu, zi, sya
+  ROMA_NIHON,       // Kunrei plus di, du, dya, wo
+  ROMA_PROFILES
+};
+
+// Output scripts, cycled with OUT_NEXT; applied to whatever the IME types
+enum {
+  OUT_KANA,       // as typed
+  OUT_FULLWIDTH,  // ASCII as U+FF01-FF5E, keys type their letter instead of kana
+  OUT_HALFWIDTH,  // kana as half-width katakana, voiced marks split off
+  OUT_SCRIPTS
+};
+
+// Persisted in the user EEPROM word
+typedef union {
+  uint32_t raw;
+  struct {
+    uint8_t romaji : 2;
+    uint8_t output : 2;
+  };
+} ime_config_t;
+
+// Usage counters since power-up, little-endian in the IME_HID_STATS reply
+typedef struct {
+  uint32_t keys;        // presses seen by ime_process_record
+  uint32_t kana;        // characters typed by the romaji matcher or kana keys
+  uint32_t backspaces;  // backspaces the IME typed to replace its own text
+  uint32_t abandoned;   // compositions dropped unmatched, cut off or timed out
+  uint32_t reports;     // keyboard HID reports sent to the host
+} ime_stats_t;
+
+_Static_assert(2 + sizeof(ime_stats_t) <= IME_HID_REPORT_SIZE, "ime_stats_t outgrew the report");
+
 // Lifecycle functions called from keymap.c hooks
+void     ime_init(void);
 void     ime_matrix_scan(void);
 bool     ime_process_record(uint16_t keycode, keyrecord_t *record);
 
+void     ime_raw_hid_receive(uint8_t *data, uint8_t length);
+
 // Exposed so keymap.c can call clear if needed
 void     clear_recent_keys(void);
@@ -0,0 +1,15 @@
+/* Generated by host/kanapack.py, do not edit. */
+
+#pragma once
+
+#define KANA_SHIFT 62
+#define KANA_ESCAPE 63
+#define KANA_KATAKANA 0x0000  // toggle entry in kana_secondary
+
+static const uint16_t PROGMEM kana_primary[] = {
+  0x306E, 0x3044, 0x3046, 0x3057, 0x304B, 0x3093, 0x305F, 0x3066, 0x3068, 0x306B, 0x306F, 0x306A, 0x308B, 0x3059, 0x3067, 0x304C, 0x307E, 0x3082, 0x3053, 0x308C, 0x3089, 0x308A, 0x304A, 0x304F, 0x304D, 0x3042, 0x3055, 0x3063, 0x3087, 0x3060, 0x3051, 0x3064, 0x3088, 0x305B, 0x305D, 0x3048, 0x308F, 0x3092, 0x3061, 0x3069, 0x3058, 0x3081, 0x307F, 0x308D, 0x3084, 0x3083, 0x307B, 0x3054, 0x3072, 0x306D, 0x3075, 0x3085, 0x3070, 0x3079, 0x3076, 0x305A, 0x3052, 0x3080, 0x3001, 0x3002, 0x30FC
+};
+
+static const uint16_t PROGMEM kana_secondary[] = {
+  0x3041, 0x3043, 0x3045, 0x3047, 0x3049, 0x304E, 0x3050, 0x3056, 0x305C, 0x305E, 0x3062, 0x3065, 0x306C, 0x3071, 0x3073, 0x3074, 0x3077, 0x3078, 0x307A, 0x307C, 0x307D, 0x3086, 0x308E, 0x3090, 0x3091, 0x3094, 0x3095, 0x3096, 0x300C, 0x300D, 0x30FB, 0xFF01, 0xFF1F, 0x3000, 0x0000, 0x69D8, 0x9858, 0x75B2, 0x5931, 0x793C, 0x4E86, 0x89E3, 0x4E16, 0x8A71, 0x4F1A, 0x793E, 0x65E5, 0x672C, 0x6642, 0x9593, 0x4ECA, 0x5E74, 0x6708, 0x4EBA, 0x5927, 0x4E2D, 0x4E8B, 0x8005, 0x65B9, 0x4F55, 0x79C1, 0x7533, 0x81F4, 0x5FA1
+};
@@ -20,6 +20,10 @@
 #include "jp_ime.h"
 
 // Delegate QMK hooks to the IME module
+void keyboard_post_init_user(void) {
+    ime_init();
+}
+
 void matrix_scan_user(void) {
     ime_matrix_scan();
 }
@@ -28,6 +32,10 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
     return ime_process_record(keycode, record);
 }
 
+void raw_hid_receive(uint8_t *data, uint8_t length) {
+    ime_raw_hid_receive(data, length);
+}
+
 const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
 
 /* Base
@@ -68,38 +76,18 @@ const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
 */
 
 [HIRAGANA] = LAYOUT_preonic_grid(
-  QK_GESC          , UC(JP_NUM_1), UC(JP_NUM_2), UC(JP_NUM_3), UC(JP_NUM_4), UC(JP_NUM_5), KC_DEL , UC(JP_NUM_6), UC(JP_NUM_7)   , UC(JP_NUM_8) , UC(JP_NUM_9)  , UC(JP_NUM_10)  ,
-  KC_TAB           , KC_NO       , KC_W        , UC(HRGN_E)  , KC_R        , KC_T        , KC_BSPC, KC_Y        , UC(HRGN_U)     , UC(HRGN_I)   , UC(HRGN_O)    , KC_P           ,
-  MO(GUIS)         , UC(HRGN_A)  , KC_S        , KC_D        , KC_F        , KC_G        , KC_ENT , KC_H        , KC_J           , KC_K         , KC_NO         , UC(SYM_DAKUTEN),
-  MO(HIRAGANA_SUPP), KC_Z        , KC_NO       , KC_C        , KC_V        , KC_B        , KC_TAB , UC(HRGN_N)  , KC_M           , UC(SYM_COMMA), UC(SYM_PERIOD), KC_SLSH        ,
-  KC_LCTL          , KC_LALT     , KC_LGUI     , MO(GUIS)    , MO(FUNCS)   , KC_SPC      , KC_SPC , KC_NO       , UC(SYM_LONGVOW), KC_DEL       , KC_INS        , KC_ENT)        ,
-
-/* HIRAGANA_SUPP is a pseudoshifted layer; pressing and holding shift provides access
-   to size-shifted chars and square/angle brackets. */
-
-[HIRAGANA_SUPP] = LAYOUT_preonic_grid(
-  UC(SYM_TILDE), UC(SYM_BANG) , UC(SYM_AT), UC(SYM_HASH) , UC(SYM_YEN), KC_NO          , KC_TRNS, KC_NO     , KC_NO        , KC_NO         , UC(SYM_KAKKO1), UC(SYM_KAKKO2)    ,
-  KC_TRNS      , KC_TRNS      , KC_TRNS   , UC(HRGN_E_SM), KC_TRNS    , UC(HRGN_TSU_SM), KC_TRNS, KC_TRNS   , UC(HRGN_U_SM), UC(HRGN_I_SM) , UC(HRGN_O_SM) , KC_TRNS           ,
-  KC_NO        , UC(HRGN_A_SM), KC_TRNS   , KC_TRNS      , KC_TRNS    , KC_TRNS        , KC_TRNS, KC_TRNS   , KC_TRNS      , KC_TRNS       , KC_TRNS       , UC(SYM_HANDAKUTEN),
-  KC_TRNS      , KC_TRNS      , KC_TRNS   , KC_TRNS      , KC_TRNS    , KC_TRNS        , KC_TRNS, UC(HRGN_N), KC_TRNS      , UC(SYM_KAKKO3), UC(SYM_KAKKO4), UC(SYM_INTERRO)   ,
-  KC_LCTL      , KC_TRNS      , KC_TRNS   , KC_TRNS      , KC_TRNS    , KC_TRNS        , KC_TRNS, KC_NO     , KC_TRNS      , UC_NEXT       , ENG_GO        , KC_TRNS)          ,
+  QK_GESC , UM(NUM_1) , UM(NUM_2), UM(NUM_3) , UM(NUM_4), UM(NUM_5), KC_DEL , UM(NUM_6) , UM(NUM_7)       , UM(NUM_8)     , UM(NUM_9)      , UM(NUM_10)      ,
+  KC_TAB  , KC_NO     , KC_W     , UM(KANA_E), KC_R     , KC_T     , KC_BSPC, KC_Y      , UM(KANA_U)      , UM(KANA_I)    , UM(KANA_O)     , KC_P            ,
+  MO(GUIS), UM(KANA_A), KC_S     , KC_D      , KC_F     , KC_G     , KC_ENT , KC_H      , KC_J            , KC_K          , KC_L           , UM(KANA_DAKUTEN),
+  KC_LSFT , KC_Z      , KC_X     , KC_C      , KC_V     , KC_B     , KC_TAB , UM(KANA_N), KC_M            , UM(MARK_COMMA), UM(MARK_PERIOD), KC_SLSH         ,
+  KC_LCTL , KC_LALT   , KC_LGUI  , MO(GUIS)  , MO(FUNCS), KC_SPC   , KC_SPC , KC_NO     , UM(KANA_LONGVOW), KC_DEL        , KC_INS         , KC_ENT)         ,
 
 [KATAKANA] = LAYOUT_preonic_grid(
-  QK_GESC          , UC(JP_NUM_1), UC(JP_NUM_2), UC(JP_NUM_3), UC(JP_NUM_4), UC(JP_NUM_5), KC_DEL , UC(JP_NUM_6), UC(JP_NUM_7)   , UC(JP_NUM_8) , UC(JP_NUM_9)  , UC(JP_NUM_10)  ,
-  KC_TAB           , KC_NO       , KC_W        , UC(KTKN_E)  , KC_R        , KC_T        , KC_BSPC, KC_Y        , UC(KTKN_U)     , UC(KTKN_I)   , UC(KTKN_O)    , KC_P           ,
-  MO(GUIS)         , UC(KTKN_A)  , KC_S        , KC_D        , KC_F        , KC_G        , KC_ENT , KC_H        , KC_J           , KC_K         , KC_NO         , UC(SYM_DAKUTEN),
-  MO(KATAKANA_SUPP), KC_Z        , KC_NO       , KC_C        , KC_V        , KC_B        , KC_TAB , UC(KTKN_N)  , KC_M           , UC(SYM_COMMA), UC(SYM_PERIOD), KC_SLSH        ,
-  KC_LCTL          , KC_LALT     , KC_LGUI     , MO(GUIS)    , MO(FUNCS)   , KC_SPC      , KC_SPC , KC_NO       , UC(SYM_LONGVOW), KC_DEL       , KC_INS        , KC_ENT)        ,
-
-/* KATAKANA_SUPP is a pseudoshifted layer; pressing and holding shift provides access
-   to size-shifted chars and square/angle brackets. */
-
-[KATAKANA_SUPP] = LAYOUT_preonic_grid(
-  UC(SYM_TILDE), UC(SYM_BANG) , UC(SYM_AT), UC(SYM_HASH) , UC(SYM_YEN), KC_NO          , KC_TRNS, KC_NO     , KC_NO          , KC_NO         , UC(SYM_KAKKO1), UC(SYM_KAKKO2)    ,
-  KC_TRNS      , KC_TRNS      , KC_TRNS   , UC(KTKN_E_SM), KC_TRNS    , UC(KTKN_TSU_SM), KC_TRNS, KC_TRNS   , UC(KTKN_U_SM)  , UC(KTKN_I_SM) , UC(KTKN_O_SM) , KC_TRNS           ,
-  KC_NO        , UC(KTKN_A_SM), KC_TRNS   , KC_TRNS      , KC_TRNS    , KC_TRNS        , KC_TRNS, KC_TRNS   , KC_TRNS        , KC_TRNS       , KC_TRNS       , UC(SYM_HANDAKUTEN),
-  KC_TRNS      , KC_TRNS      , KC_TRNS   , KC_TRNS      , KC_TRNS    , KC_TRNS        , KC_TRNS, UC(KTKN_N), KC_TRNS        , UC(SYM_KAKKO3), UC(SYM_KAKKO4), UC(SYM_INTERRO)   ,
-  KC_LCTL      , KC_TRNS      , KC_TRNS   , KC_TRNS      , KC_TRNS    , KC_TRNS        , KC_TRNS, KC_NO     , UC(SYM_LONGVOW), UC_NEXT       , ENG_GO        , KC_TRNS)          ,
+  QK_GESC , UM(NUM_1) , UM(NUM_2), UM(NUM_3) , UM(NUM_4), UM(NUM_5), KC_DEL , UM(NUM_6) , UM(NUM_7)       , UM(NUM_8)     , UM(NUM_9)      , UM(NUM_10)      ,
+  KC_TAB  , KC_NO     , KC_W     , UM(KANA_E), KC_R     , KC_T     , KC_BSPC, KC_Y      , UM(KANA_U)      , UM(KANA_I)    , UM(KANA_O)     , KC_P            ,
+  MO(GUIS), UM(KANA_A), KC_S     , KC_D      , KC_F     , KC_G     , KC_ENT , KC_H      , KC_J            , KC_K          , KC_L           , UM(KANA_DAKUTEN),
+  KC_LSFT , KC_Z      , KC_X     , KC_C      , KC_V     , KC_B     , KC_TAB , UM(KANA_N), KC_M            , UM(MARK_COMMA), UM(MARK_PERIOD), KC_SLSH         ,
+  KC_LCTL , KC_LALT   , KC_LGUI  , MO(GUIS)  , MO(FUNCS), KC_SPC   , KC_SPC , KC_NO     , UM(KANA_LONGVOW), KC_DEL        , KC_INS         , KC_ENT)         ,
 
 /* FUNCS provides all the remaining functional keys absent from a 60%;
    - Function keys align with their single digit counterparts. See QW
@@ -124,3 +112,63 @@ const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
   KC_LCTL, KC_LALT   , KC_NO        , KC_TRNS      , KC_TRNS      , KC_NO     , KC_NO        , KC_NO       , KC_NO     , HRGA_GO   , KTKN_GO   , LGUI(KC_END)),
 
 };
+
+/* Shift on the kana layers gives size-shifted chars and square/angle brackets.
+   jp_ime.c takes the shifted form of each kana, numeral and mark key from
+   unicode.def; HIRAGANA_SUPP and KATAKANA_SUPP hold the rest, and are only
+   read, never turned on. Being mostly KC_TRNS, they keep only the keys
+   they set: SK(grid row, grid column, keycode), in reading order. */
+
+typedef struct __attribute__((packed)) {
+    uint8_t  pos;  // grid row * 12 + grid column
+    uint16_t keycode;
+} sparse_key_t;
+
+#define SK(row, col, keycode) { (row) * 12 + (col), keycode }
+
+static const sparse_key_t PROGMEM hiragana_supp[] = {
+  SK(0,  0, UM(MARK_TILDE)),
+  SK(1,  5, UM(KANA_TSU_SM)),
+  SK(3, 11, UM(MARK_INTERRO)),
+  SK(4,  9, UC_NEXT), SK(4, 10, ENG_GO),
+};
+
+static const sparse_key_t PROGMEM katakana_supp[] = {
+  SK(0,  0, UM(MARK_TILDE)),
+  SK(1,  5, UM(KANA_TSU_SM)),
+  SK(3, 11, UM(MARK_INTERRO)),
+  SK(4,  9, UC_NEXT), SK(4, 10, ENG_GO),
+};
+
+// LAYOUT_preonic_grid puts the right half of each grid row on matrix rows 5-9
+static uint16_t sparse_keycode(const sparse_key_t *keys, uint8_t count, keypos_t key) {
+    uint8_t pos = key.row % 5 * 12 + key.row / 5 * 6 + key.col;
+    uint8_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint8_t mid = (lo + hi) / 2;
+        uint8_t at  = pgm_read_byte(&keys[mid].pos);
+        if (at == pos) {
+            return pgm_read_word(&keys[mid].keycode);
+        }
+        if (at < pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return KC_TRNS;
+}
+
+// Sparse layers are looked up here, before the dense keymaps above.
+uint16_t keymap_key_to_keycode(uint8_t layer, keypos_t key) {
+    if (key.row >= MATRIX_ROWS || key.col >= MATRIX_COLS) {
+        return KC_NO;
+    }
+    switch (layer) {
+    case HIRAGANA_SUPP:
+        return sparse_keycode(hiragana_supp, ARRAY_SIZE(hiragana_supp), key);
+    case KATAKANA_SUPP:
+        return sparse_keycode(katakana_supp, ARRAY_SIZE(katakana_supp), key);
+    }
+    return keycode_at_keymap_location(layer, key.row, key.col);
+}
@@ -1,5 +1,38 @@
-UNICODE_ENABLE = yes
+UNICODEMAP_ENABLE = yes  # kana layer keys, see unicode.def
 COMBO_ENABLE = no
+RAW_ENABLE = yes
+IME_HENKAN_ENABLE = no  # kana-to-kanji on Space, see henkan.dic
+IME_HEATMAP_ENABLE = yes  # per-layer press counts, read with host/heatmap.py
+IME_HOLD_ENABLE = no  # hold a vowel for its small kana, ん for っ
+IME_EMIT_THREAD_ENABLE = no  # type from a ChibiOS thread fed by emit_queue.h
+IME_TRACE_ENABLE = no  # key-to-report latency, printed on the console by IME_TRACE
+IME_CAPTURE_ENABLE = no  # event stream for host/sim/replay, printed by IME_CAPTURE
 
 VPATH += keyboards/gboards
 SRC += jp_ime.c
+
+ifeq ($(strip $(IME_HENKAN_ENABLE)), yes)
+    OPT_DEFS += -DIME_HENKAN_ENABLE
+endif
+
+ifeq ($(strip $(IME_HEATMAP_ENABLE)), yes)
+    OPT_DEFS += -DIME_HEATMAP_ENABLE
+endif
+
+ifeq ($(strip $(IME_HOLD_ENABLE)), yes)
+    OPT_DEFS += -DIME_HOLD_ENABLE
+endif
+
+ifeq ($(strip $(IME_EMIT_THREAD_ENABLE)), yes)
+    OPT_DEFS += -DIME_EMIT_THREAD_ENABLE
+endif
+
+ifeq ($(strip $(IME_TRACE_ENABLE)), yes)
+    CONSOLE_ENABLE = yes
+    OPT_DEFS += -DIME_TRACE_ENABLE
+endif
+
+ifeq ($(strip $(IME_CAPTURE_ENABLE)), yes)
+    CONSOLE_ENABLE = yes
+    OPT_DEFS += -DIME_CAPTURE_ENABLE
+endif
@@ -0,0 +1,20 @@
+/* Generated by host/kanapack.py, do not edit. */
+
+#pragma once
+
+// おはようございます
+static const uint8_t PROGMEM snip_OHY[] = { 0x5C, 0xB8, 0x43, 0xC3, 0xE1, 0xC2, 0x44, 0xE0, 0x00 };
+// よろしくお願いします
+static const uint8_t PROGMEM snip_YRS[] = { 0x86, 0xC1, 0x18, 0x5F, 0xE9, 0x02, 0x11, 0x13, 0x80 };
+// お疲れ様です
+static const uint8_t PROGMEM snip_OTS[] = { 0x5F, 0xE9, 0x54, 0xFA, 0x33, 0xCE, 0x00 };
+// ありがとうございます
+static const uint8_t PROGMEM snip_ARG[] = { 0x69, 0x64, 0x09, 0x0F, 0x0F, 0x87, 0x09, 0x13, 0x80 };
+// お世話になっております
+static const uint8_t PROGMEM snip_OSW[] = { 0x5F, 0xEA, 0xBE, 0xAC, 0xA3, 0x1C, 0x21, 0x75, 0x91, 0x38, 0x00 };
+// すみません
+static const uint8_t PROGMEM snip_SMS[] = { 0x3A, 0xB4, 0x62, 0x18, 0x00 };
+// 失礼します
+static const uint8_t PROGMEM snip_SSN[] = { 0xFA, 0x6F, 0xA7, 0x11, 0x13, 0x80 };
+// 了解しました
+static const uint8_t PROGMEM snip_RKI[] = { 0xFA, 0x8F, 0xA9, 0x11, 0x11, 0x07, 0x00 };